@@ -0,0 +1,286 @@
+#include "bulk_log.h"
+#include "crc8.h"
+#include "eeprom_ring.h"
+#include "sample_codec.h"
+
+BulkLog::BulkLog(SdCard &card, uint32_t firstBlock, uint32_t blocks)
+  : card(card), first(firstBlock), blocks(blocks), logState(BULK_OFF), sequence(0), clock(0),
+    dropped(0), errors(0), fill(BULK_HEADER_SIZE), blockTime(0), blockFull(false), runAt(0),
+    runLast(0), indexWrite(false), indexCopy(0),
+    sendPos(0), crc(CRC8_INIT), recoverStep(0), lo(0), hi(0) {
+}
+
+bool BulkLog::begin() {
+  resetBlock();
+  if (!card.begin()) {
+    logState = BULK_OFF;
+    return false;
+  }
+  logState = BULK_STARTING;
+  return true;
+}
+
+void BulkLog::resetBlock() {
+  memset(block, 0, sizeof(block));
+  fill = BULK_HEADER_SIZE;
+  blockFull = false;
+  runAt = 0;
+}
+
+bool BulkLog::stage(BulkRecord &record) {
+  record.time = millis();
+  if (logState == BULK_OFF || !staged.push(record)) {
+    if (dropped < 0xFFFF) {
+      dropped++;
+    }
+    return false;
+  }
+  return true;
+}
+
+bool BulkLog::logSample(int32_t raw) {
+  BulkRecord r;
+  r.type = BULK_SAMPLES;
+  r.length = 4;
+  ringWriteU32(r.data, (uint32_t) raw);
+  return stage(r);
+}
+
+bool BulkLog::logLoad(int32_t payload, int32_t peak, uint16_t duration) {
+  BulkRecord r;
+  r.type = BULK_LOAD;
+  r.length = 10;
+  ringWriteU32(r.data, (uint32_t) payload);
+  ringWriteU32(r.data + 4, (uint32_t) peak);
+  r.data[8] = duration & 0xFF;
+  r.data[9] = duration >> 8;
+  return stage(r);
+}
+
+// Move staged records into the block buffer until it is full
+void BulkLog::pack() {
+  BulkRecord r;
+  while (!blockFull && staged.peek(r)) {
+    if (packRecord(r)) {
+      staged.pop(r);
+    } else {
+      blockFull = true;  // r goes first into the next block
+    }
+  }
+}
+
+// Append r to the block, extending the open sample run if it is a sample.
+// Returns false if it doesn't fit.
+bool BulkLog::packRecord(const BulkRecord &r) {
+  int32_t value = (int32_t) ringReadU32(r.data);
+  if (r.type == BULK_SAMPLES && runAt != 0) {
+    uint8_t n = deltaSize(runLast, value);
+    if (block[runAt + 1] + n <= 0xFF) {
+      if (fill + n > SD_BLOCK_SIZE - 1) {
+        return false;
+      }
+      putDelta(block + fill, runLast, value);
+      block[runAt + 1] += n;
+      fill += n;
+      return true;
+    }
+  }
+
+  if (fill + BULK_RECORD_HEADER + r.length > SD_BLOCK_SIZE - 1) {
+    return false;
+  }
+  if (fill == BULK_HEADER_SIZE) {
+    blockTime = r.time;
+    ringWriteU32(block + 12, clock);
+  }
+  uint32_t dt = r.time - blockTime;
+  if (dt > 0xFFFF) {
+    dt = 0xFFFF;
+  }
+  uint8_t *p = block + fill;
+  p[0] = r.type;
+  p[1] = r.length;
+  p[2] = dt & 0xFF;
+  p[3] = dt >> 8;
+  memcpy(p + BULK_RECORD_HEADER, r.data, r.length);
+  runAt = r.type == BULK_SAMPLES ? fill : 0;
+  runLast = value;
+  fill += BULK_RECORD_HEADER + r.length;
+  block[3]++;
+  return true;
+}
+
+// Whether the block for seq holds that sequence, intact
+bool BulkLog::blockWritten(uint32_t seq) {
+  uint8_t h[8];
+  bool crcOk = false;
+  return card.read(dataBlock(seq), h, sizeof(h), &crcOk) && crcOk &&
+         (h[0] | (uint16_t) h[1] << 8) == BULK_BLOCK_MAGIC && h[2] == BULK_LOG_VERSION &&
+         ringReadU32(h + 4) == seq;
+}
+
+bool BulkLog::readBlock(uint32_t seq, uint16_t offset, uint8_t *dst, uint16_t len) {
+  return logState == BULK_IDLE && retained(seq) && card.read(dataBlock(seq), dst, len, 0, offset);
+}
+
+// One card read per call. Returns true once sequence is the next block to
+// write; a region without a valid index for this geometry starts afresh.
+bool BulkLog::recover() {
+  if (recoverStep < 2) {
+    uint8_t h[12];
+    bool crcOk = false;
+    if (card.read(first + recoverStep, h, sizeof(h), &crcOk) && crcOk &&
+        (h[0] | (uint16_t) h[1] << 8) == BULK_INDEX_MAGIC && h[2] == BULK_LOG_VERSION &&
+        ringReadU32(h + 4) == blocks && (hi == 0 || ringReadU32(h + 8) >= lo)) {
+      lo = ringReadU32(h + 8);
+      hi = lo + BULK_INDEX_INTERVAL;
+      indexCopy = recoverStep ^ 1;
+    }
+    recoverStep++;
+    return false;
+  }
+  if (hi == 0) {
+    sequence = 0;
+    return true;
+  }
+
+  // Blocks [lo, next) were written after the index, [next, hi] weren't
+  if (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (blockWritten(mid)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+    return false;
+  }
+  sequence = lo;
+  return true;
+}
+
+uint8_t BulkLog::indexByte(uint16_t i) const {
+  switch (i) {
+    case 0:  return BULK_INDEX_MAGIC & 0xFF;
+    case 1:  return BULK_INDEX_MAGIC >> 8;
+    case 2:  return BULK_LOG_VERSION;
+  }
+  if (i >= 4 && i < 16) {
+    uint32_t v = i < 8 ? blocks : (i < 12 ? sequence : clock);
+    return v >> (8 * (i % 4));
+  }
+  return 0;
+}
+
+void BulkLog::startWrite(bool index) {
+  indexWrite = index;
+  if (!index) {
+    block[0] = BULK_BLOCK_MAGIC & 0xFF;
+    block[1] = BULK_BLOCK_MAGIC >> 8;
+    block[2] = BULK_LOG_VERSION;
+    ringWriteU32(block + 4, sequence);
+    ringWriteU32(block + 8, blockTime);
+  }
+  if (!card.writeStart(index ? first + indexCopy : dataBlock(sequence))) {
+    writeFailed();
+    return;
+  }
+  sendPos = 0;
+  crc = CRC8_INIT;
+  logState = BULK_SENDING;
+}
+
+// BULK_WRITE_CHUNK bytes per call, the CRC accumulated on the way
+void BulkLog::sendChunk() {
+  uint16_t end = sendPos + BULK_WRITE_CHUNK;
+  if (end > SD_BLOCK_SIZE - 1) {
+    end = SD_BLOCK_SIZE - 1;
+  }
+  for (; sendPos < end; sendPos++) {
+    uint8_t b = indexWrite ? indexByte(sendPos) : block[sendPos];
+    crc = crc8Update(crc, b);
+    card.writeByte(b);
+  }
+  if (sendPos < SD_BLOCK_SIZE - 1) {
+    return;
+  }
+  card.writeByte(crc);
+  if (!card.writeEnd()) {
+    writeFailed();
+    return;
+  }
+
+  // The card has the block, so the buffer is free for the next one
+  errors = 0;
+  if (indexWrite) {
+    indexCopy ^= 1;
+  } else {
+    sequence++;
+    resetBlock();
+  }
+  logState = BULK_PROGRAMMING;
+}
+
+// A rejected block stays in the buffer for another go
+void BulkLog::writeFailed() {
+  logState = ++errors >= BULK_MAX_ERRORS ? BULK_OFF : BULK_IDLE;
+}
+
+void BulkLog::service() {
+  switch (logState) {
+    case BULK_OFF:
+      staged.clear();
+      return;
+
+    case BULK_STARTING:
+      switch (card.startUp()) {
+        case SD_READY:
+          recoverStep = 0;
+          lo = hi = 0;
+          logState = BULK_RECOVERING;
+          break;
+        case SD_FAILED:
+          logState = BULK_OFF;
+          return;
+        default:
+          break;
+      }
+      break;
+
+    case BULK_RECOVERING:
+      if (recover()) {
+        logState = BULK_IDLE;
+        if (hi == 0) {
+          startWrite(true);  // fresh log: index it before the first block
+        }
+      }
+      break;
+
+    case BULK_SENDING:
+      sendChunk();
+      break;
+
+    case BULK_PROGRAMMING:
+      if (!card.busy()) {
+        logState = BULK_IDLE;
+        if (!indexWrite && sequence % BULK_INDEX_INTERVAL == 0) {
+          startWrite(true);
+        }
+      }
+      break;
+
+    case BULK_IDLE:
+      break;
+  }
+
+  // The buffer is in use while a data block goes out
+  if (logState == BULK_SENDING && !indexWrite) {
+    return;
+  }
+  pack();
+
+  // A full block goes out, and so does a partly filled one once it is old
+  if (logState == BULK_IDLE && fill > BULK_HEADER_SIZE &&
+      (blockFull || millis() - blockTime >= BULK_FLUSH_AGE)) {
+    startWrite(false);
+  }
+}
@@ -0,0 +1,172 @@
+/**
+ * Append-only sample and load history on an SD card (sd_card.h), in whole
+ * 512-byte blocks.
+ *
+ * Records are staged in a small queue, packed into a block buffer in RAM
+ * and the block goes out once full (or BULK_FLUSH_AGE after its first
+ * record), BULK_WRITE_CHUNK bytes per service() call, so neither the
+ * sampling path nor any other task waits on the card. The log is a ring
+ * over a region of the card: the block for sequence number s is
+ * firstBlock + 2 + s % blocks, and the oldest blocks are overwritten once
+ * it wraps.
+ *
+ * Header index: the first two blocks of the region are A/B copies of an
+ * index, rewritten every BULK_INDEX_INTERVAL blocks. At start-up the newer
+ * copy gives the next sequence to within BULK_INDEX_INTERVAL and a binary
+ * search over the block headers after it finds the exact one (about eight
+ * reads, one per service() call). Every block header carries its sequence
+ * number and the seconds clock, and both only ever grow along the ring,
+ * so a reader seeks to a point in time by bisecting block headers.
+ *
+ * Index block, little endian:
+ *   0  uint16 BULK_INDEX_MAGIC
+ *   2  uint8  BULK_LOG_VERSION
+ *   4  uint32 data blocks in the ring
+ *   8  uint32 next sequence to be written
+ *   12 uint32 seconds clock when it was written
+ *   511 CRC-8 of bytes 0-510 (the rest is zero)
+ *
+ * Data block:
+ *   0  uint16 BULK_BLOCK_MAGIC
+ *   2  uint8  BULK_LOG_VERSION
+ *   3  uint8  record count
+ *   4  uint32 sequence
+ *   8  uint32 millis() at the first record
+ *   12 uint32 seconds clock at the first record
+ *   16 records, then zeros up to
+ *   511 CRC-8 of bytes 0-510
+ *
+ * Record: uint8 type, uint8 data length, uint16 milliseconds since the
+ * block's first record, then the data:
+ *   BULK_SAMPLES int32 raw count (sum of all channels), then each
+ *                following conversion as a zig-zag varint delta
+ *                (sample_codec.h); the time is that of the first
+ *   BULK_LOAD    int32 payload, int32 peak (grams), uint16 duration (s)
+ * Readers skip record types they don't know by their length. A run of
+ * samples grows until the block is full, another record comes in or its
+ * length reaches 255 bytes. A block holds around 300-400 conversions on
+ * the bundled traces, against 61 at a record of their own each.
+ *
+ * Costs about 680 bytes of SRAM, a third of the Uno's, hence the build
+ * option: BULK_LOG_ENABLED (0 by default, -DBULK_LOG_ENABLED=1 to build
+ * it in).
+ */
+
+#ifndef BULK_LOG_H
+#define BULK_LOG_H
+
+#include <Arduino.h>
+#include "sd_card.h"
+#include "ring_buffer.h"
+
+#ifndef BULK_LOG_ENABLED
+#define BULK_LOG_ENABLED 0
+#endif
+
+#define BULK_INDEX_MAGIC    0x5842  // "BX"
+#define BULK_BLOCK_MAGIC    0x4B42  // "BK"
+#define BULK_LOG_VERSION    1
+#define BULK_HEADER_SIZE    16
+#define BULK_RECORD_HEADER  4
+#define BULK_RECORD_MAX     10      // data bytes
+#define BULK_STAGE_SLOTS    8       // holds 7 records, ~90 ms of samples
+#define BULK_WRITE_CHUNK    128     // bytes sent per service() call
+#define BULK_INDEX_INTERVAL 256     // blocks between index rewrites
+#define BULK_FLUSH_AGE      5000    // ms a partly filled block may wait
+#define BULK_MAX_ERRORS     3       // failed writes in a row before giving up
+
+enum BulkRecordType {
+  BULK_SAMPLES = 1,
+  BULK_LOAD = 2
+};
+
+enum BulkLogState {
+  BULK_OFF,         // no card, or it failed
+  BULK_STARTING,    // card start-up
+  BULK_RECOVERING,  // finding where the log ends
+  BULK_IDLE,
+  BULK_SENDING,     // block going out in chunks
+  BULK_PROGRAMMING  // card busy writing it
+};
+
+struct BulkRecord {
+  uint8_t type;
+  uint8_t length;
+  uint32_t time;
+  uint8_t data[BULK_RECORD_MAX];
+};
+
+class BulkLog {
+public:
+  BulkLog(SdCard &card, uint32_t firstBlock, uint32_t blocks);
+
+  // Reset the card; the log starts up over the following service() calls.
+  // Returns false if there is no card.
+  bool begin();
+
+  // Stage a record; false (and counted as dropped) when the log is off or
+  // the staging queue is full
+  bool logSample(int32_t raw);
+  bool logLoad(int32_t payload, int32_t peak, uint16_t duration);
+
+  // Seconds clock stamped on each new block
+  void setClock(uint32_t seconds) { clock = seconds; }
+
+  void service();
+
+  BulkLogState state() const { return logState; }
+  uint32_t nextSequence() const { return sequence; }
+
+  // Data blocks [oldestSequence(), nextSequence()) are on the card
+  uint32_t oldestSequence() const { return sequence > blocks ? sequence - blocks : 0; }
+  bool retained(uint32_t seq) const { return seq >= oldestSequence() && seq < sequence; }
+
+  // Read len bytes from offset of data block seq, for a download. The
+  // card is only free between the log's own writes, so this fails unless
+  // the log is IDLE (or if the read does).
+  bool readBlock(uint32_t seq, uint16_t offset, uint8_t *dst, uint16_t len);
+  uint16_t droppedRecords() const { return dropped; }
+
+private:
+  bool stage(BulkRecord &record);
+  void pack();
+  bool packRecord(const BulkRecord &r);
+  bool recover();
+  bool blockWritten(uint32_t seq);
+  void startWrite(bool index);
+  void sendChunk();
+  void writeFailed();
+  uint8_t indexByte(uint16_t i) const;
+  void resetBlock();
+  uint32_t dataBlock(uint32_t seq) const { return first + 2 + seq % blocks; }
+
+  SdCard &card;
+  uint32_t first;
+  uint32_t blocks;
+  BulkLogState logState;
+  uint32_t sequence;      // of the block being filled
+  uint32_t clock;
+  uint16_t dropped;
+  uint8_t errors;
+
+  RingBuffer<BulkRecord, BULK_STAGE_SLOTS> staged;
+  uint8_t block[SD_BLOCK_SIZE];
+  uint16_t fill;          // bytes used in block
+  uint32_t blockTime;     // millis() at its first record
+  bool blockFull;
+  uint16_t runAt;         // offset of the open BULK_SAMPLES record, 0 if none
+  int32_t runLast;        // last value in it
+
+  // Write in progress: the data block or (indexWrite) the next index copy
+  bool indexWrite;
+  uint8_t indexCopy;      // copy the next index write goes to
+  uint16_t sendPos;
+  uint8_t crc;
+
+  // Recovery: index copies still to read, then bisection over [lo, hi]
+  uint8_t recoverStep;
+  uint32_t lo;
+  uint32_t hi;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "calibration_curve.h"
+#include <EEPROM.h>
+#include "crc8.h"
+#include "eeprom_ring.h"
+
+#if defined(__AVR__)
+#include <avr/eeprom.h>
+#define EEPROM_READY() eeprom_is_ready()
+#else
+#define EEPROM_READY() true
+#endif
+
+CalibrationCurve::CalibrationCurve(int addressA, int addressB)
+  : baseA(addressA), baseB(addressB), current(1), sequence(0), step(CAL_CURVE_WRITE_STEPS) {
+  clear();
+}
+
+bool CalibrationCurve::begin() {
+  uint8_t buf[CAL_CURVE_BLOCK_SIZE];
+  bool found = false;
+
+  clear();
+  sequence = 0;
+  current = 1;  // so the first save lands in copy A
+  for (uint8_t copy = 0; copy < 2; copy++) {
+    for (uint8_t i = 0; i < CAL_CURVE_BLOCK_SIZE; i++) {
+      buf[i] = EEPROM.read(copyAddress(copy) + i);
+    }
+    if (crc8(buf, CAL_CURVE_BLOCK_SIZE - 1) != buf[CAL_CURVE_BLOCK_SIZE - 1] ||
+        buf[4] < 1 || buf[4] > CAL_CURVE_MAX_KNOTS) {
+      continue;
+    }
+    uint32_t seq = ringReadU32(buf);
+    if (seq <= sequence) {
+      continue;
+    }
+    sequence = seq;
+    current = copy;
+    found = true;
+
+    knots = buf[4];
+    for (uint8_t k = 0; k < knots; k++) {
+      knotCounts[k] = (int32_t) ringReadU32(buf + 5 + 8 * k);
+      knotGrams[k] = (int32_t) ringReadU32(buf + 9 + 8 * k);
+    }
+  }
+  if (found) {
+    build();
+  }
+  return found;
+}
+
+void CalibrationCurve::clear() {
+  if (busy()) {
+    save();  // restart a save in flight with the new knots
+  }
+  knots = 1;
+  knotCounts[0] = 0;
+  knotGrams[0] = 0;
+}
+
+bool CalibrationCurve::addPoint(int32_t counts, int32_t grams) {
+  uint8_t k = 0;
+  while (k < knots && knotCounts[k] < counts) {
+    k++;
+  }
+
+  // Re-measuring a point replaces it, but the empty scale stays as it is
+  for (uint8_t n = (k > 0 ? k - 1 : 0); n < knots && n <= k; n++) {
+    if (labs(knotCounts[n] - counts) < CAL_CURVE_MIN_SPACING) {
+      if (knotCounts[n] == 0 && knotGrams[n] == 0) {
+        return false;
+      }
+      if (busy()) {
+        save();
+      }
+      knotCounts[n] = counts;
+      knotGrams[n] = grams;
+      build();
+      return true;
+    }
+  }
+
+  if (knots >= CAL_CURVE_MAX_KNOTS) {
+    return false;
+  }
+  if (busy()) {
+    save();
+  }
+  memmove(knotCounts + k + 1, knotCounts + k, (knots - k) * sizeof(knotCounts[0]));
+  memmove(knotGrams + k + 1, knotGrams + k, (knots - k) * sizeof(knotGrams[0]));
+  knotCounts[k] = counts;
+  knotGrams[k] = grams;
+  knots++;
+  build();
+  return true;
+}
+
+void CalibrationCurve::widestPoint(int32_t &counts, int32_t &grams) const {
+  // The knots are sorted, so it is one of the two ends
+  uint8_t k = labs(knotCounts[0]) > labs(knotCounts[knots - 1]) ? 0 : knots - 1;
+  counts = knotCounts[k];
+  grams = knotGrams[k];
+}
+
+// The only divisions: one per segment, whenever the knots change
+void CalibrationCurve::build() {
+  for (uint8_t k = 0; k + 1 < knots; k++) {
+    int64_t dg = (int64_t) (knotGrams[k + 1] - knotGrams[k]) << CAL_CURVE_SLOPE_FRAC_BITS;
+    slope[k] = dg / (knotCounts[k + 1] - knotCounts[k]);
+  }
+}
+
+int32_t CalibrationCurve::toGrams(int32_t counts) const {
+  // Last segment starting at or below counts; the first and last segments
+  // also take everything beyond the ends
+  uint8_t lo = 0;
+  uint8_t hi = knots - 2;
+  while (lo < hi) {
+    uint8_t mid = (lo + hi + 1) / 2;
+    if (counts >= knotCounts[mid]) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return knotGrams[lo] + (int32_t) (((int64_t) (counts - knotCounts[lo]) * slope[lo]) >> CAL_CURVE_SLOPE_FRAC_BITS);
+}
+
+uint8_t CalibrationCurve::blockByte(uint8_t i) const {
+  if (i < 4) {
+    return (sequence + 1) >> (8 * i);
+  }
+  if (i == 4) {
+    return knots;
+  }
+  uint8_t k = (i - 5) / 8;
+  uint8_t b = (i - 5) % 8;
+  if (k >= knots) {
+    return 0;
+  }
+  uint32_t v = b < 4 ? knotCounts[k] : knotGrams[k];
+  return v >> (8 * (b % 4));
+}
+
+void CalibrationCurve::save() {
+  step = 0;
+  crc = CRC8_INIT;
+}
+
+void CalibrationCurve::service() {
+  if (!busy() || !EEPROM_READY()) {
+    return;
+  }
+
+  // Step 0 invalidates the older copy before any of its bytes change; the
+  // CRC of the new one goes in last. The bytes are serialised from the
+  // knots as they go, so nothing is buffered.
+  uint8_t copy = current ^ 1;
+  int addr = copyAddress(copy);
+  if (step == 0) {
+    EEPROM.update(addr + CAL_CURVE_BLOCK_SIZE - 1, EEPROM.read(addr + CAL_CURVE_BLOCK_SIZE - 1) ^ 0xFF);
+  } else if (step < CAL_CURVE_BLOCK_SIZE) {
+    uint8_t b = blockByte(step - 1);
+    crc = crc8Update(crc, b);
+    EEPROM.update(addr + step - 1, b);
+  } else {
+    EEPROM.update(addr + CAL_CURVE_BLOCK_SIZE - 1, crc);
+  }
+  step++;
+
+  if (!busy()) {
+    current = copy;
+    sequence++;
+  }
+}
@@ -0,0 +1,90 @@
+/**
+ * Multi-point calibration: a piecewise-linear map from net counts (the
+ * sum of all channels' tare-relative readings) to grams.
+ *
+ * Each calibration point is a known weight and the counts measured under
+ * it; together with the empty scale at (0, 0) they are the knots of the
+ * curve. The knots are kept sorted by counts with each segment's slope
+ * precomputed in fixed point, so converting a sample is a binary search
+ * over at most CAL_CURVE_MAX_POINTS segments plus one multiply and shift.
+ * Beyond the outermost knots the end segments are extended.
+ *
+ * The knots are saved as a CRC-checked block in two copies (A and B) that
+ * alternate as in ConfigStore: a save goes to the older copy with the next
+ * sequence number, and begin() takes the newest valid one, so a save cut
+ * short by a power loss or a watchdog reset leaves the previous curve. The
+ * block is written one byte per service() call (CRC last). Changing the
+ * knots while they are being saved restarts the save.
+ *
+ * Block layout (little endian):
+ *   0  uint32 sequence (1 for the first save)
+ *   4  uint8  number of knots, including the empty scale
+ *   5  per knot: int32 counts, int32 grams, CAL_CURVE_MAX_POINTS + 1 of them
+ *   77 uint8  CRC-8 of bytes 0..76
+ */
+
+#ifndef CALIBRATION_CURVE_H
+#define CALIBRATION_CURVE_H
+
+#include <Arduino.h>
+
+#define CAL_CURVE_MAX_POINTS 8
+#define CAL_CURVE_MAX_KNOTS (CAL_CURVE_MAX_POINTS + 1)
+#define CAL_CURVE_BLOCK_SIZE (6 + 8 * CAL_CURVE_MAX_KNOTS)
+#define CAL_CURVE_WRITE_STEPS (CAL_CURVE_BLOCK_SIZE + 1)
+#define CAL_CURVE_SLOPE_FRAC_BITS 20
+
+// Points closer together than this (counts) are taken as the same point
+#define CAL_CURVE_MIN_SPACING 100
+
+class CalibrationCurve {
+public:
+  CalibrationCurve(int addressA, int addressB);
+
+  // Load the newest saved copy. Returns false (leaving the curve empty) if
+  // neither copy is valid.
+  bool begin();
+
+  // Drop every point, back to the empty scale alone
+  void clear();
+
+  // Add a point measured under a known weight; one at (close to) the same
+  // counts as an existing point replaces it. Returns false if the curve is
+  // full or the counts are too close to the empty scale.
+  bool addPoint(int32_t counts, int32_t grams);
+
+  uint8_t pointCount() const { return knots - 1; }
+
+  // The measured point furthest from the empty scale (pointCount() > 0)
+  void widestPoint(int32_t &counts, int32_t &grams) const;
+
+  // A single point is just a calibration factor; the curve is only used
+  // for the weight from two points on
+  bool active() const { return knots > 2; }
+
+  int32_t toGrams(int32_t counts) const;
+
+  // Stage the curve for saving; service() writes it one byte per call
+  void save();
+  void service();
+  bool busy() const { return step < CAL_CURVE_WRITE_STEPS; }
+
+private:
+  void build();
+  uint8_t blockByte(uint8_t i) const;
+  int copyAddress(uint8_t copy) const { return copy ? baseB : baseA; }
+
+  int baseA;
+  int baseB;
+  uint8_t current;    // copy holding the saved curve
+  uint32_t sequence;  // of the saved curve
+  uint8_t knots;
+  int32_t knotCounts[CAL_CURVE_MAX_KNOTS];
+  int32_t knotGrams[CAL_CURVE_MAX_KNOTS];
+  int32_t slope[CAL_CURVE_MAX_POINTS];  // grams per count from each knot to the next
+
+  uint8_t step;  // next write step, CAL_CURVE_WRITE_STEPS when idle
+  uint8_t crc;   // CRC of the bytes written so far
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "command_parser.h"
+#include "crc8.h"
+#include "telemetry.h"
+
+CommandParser::CommandParser()
+  : state(WAIT_SYNC), frameLen(0), frameType(0), len(0), crc(CRC8_INIT), badFrames(0) {
+}
+
+bool CommandParser::feed(uint8_t b) {
+  switch (state) {
+    case WAIT_SYNC:
+      if (b == TELEMETRY_SYNC) {
+        state = WAIT_LENGTH;
+      }
+      return false;
+
+    case WAIT_LENGTH:
+      if (b == 0 || b > COMMAND_MAX_PAYLOAD + 1) {
+        badFrames++;
+        state = b == TELEMETRY_SYNC ? WAIT_LENGTH : WAIT_SYNC;
+        return false;
+      }
+      frameLen = b;
+      crc = crc8Update(CRC8_INIT, b);
+      state = WAIT_TYPE;
+      return false;
+
+    case WAIT_TYPE:
+      frameType = b;
+      crc = crc8Update(crc, b);
+      len = 0;
+      state = frameLen > 1 ? WAIT_PAYLOAD : WAIT_CRC;
+      return false;
+
+    case WAIT_PAYLOAD:
+      buf[len++] = b;
+      crc = crc8Update(crc, b);
+      if (len == frameLen - 1) {
+        state = WAIT_CRC;
+      }
+      return false;
+
+    case WAIT_CRC:
+      state = WAIT_SYNC;
+      if (b != crc) {
+        badFrames++;
+        return false;
+      }
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,111 @@
+/**
+ * Incremental parser for request frames from the host.
+ *
+ * Requests use the telemetry framing (telemetry.h) in the other direction:
+ *   0xA5 sync | len | type | payload (len - 1 bytes) | CRC-8 of len..payload
+ * feed() takes one received byte at a time, so the caller can drain the
+ * UART a few bytes per scheduler pass into this fixed buffer. A frame is
+ * only reported once its CRC checks out; bad or oversized frames are
+ * counted and the parser hunts for the next sync byte.
+ *
+ * Every request is answered by a frame of type (request | COMMAND_REPLY)
+ * whose payload starts with a CommandStatus byte. Payloads, little endian:
+ *
+ *   CMD_STATUS          -> uint32 uptime (ms), int32 weight (g), uint8
+ *                          flags (COMMAND_FLAG_*), uint32 clock (s),
+ *                          uint16 dropped samples, uint16 dropped packets,
+ *                          uint8 history state (BulkLogState, BULK_OFF
+ *                          when not built in), uint32 next history block,
+ *                          uint8 faults (FAULT_*, fault_monitor.h), uint8
+ *                          faulty channels (bit per channel)
+ *   CMD_TOTALS          -> uint16 load count, int64 total (g)
+ *   CMD_STATS           uint8 aggregate (TelemetryStatsKind)
+ *                       -> the TELEMETRY_STATS payload
+ *   CMD_SET_CALIBRATION int32 raw counts per kg, CAL_FACTOR_FRAC_BITS
+ *                       fractional bits, for every channel; replaces a
+ *                       multi-point curve
+ *   CMD_SET_TARGET      int32 target payload (g, 0 = none), uint8
+ *                       overload margin (%)
+ *   CMD_SET_CLOCK       uint32 seconds since midnight of some day 0
+ *   CMD_TARE            (BUSY while calibrating or already averaging)
+ *   CMD_RESET           clears the totals, as the Reset button does
+ *   CMD_READ_LOADS      uint32 first sequence, uint8 count
+ *                       -> per load still in the log: uint32 sequence,
+ *                          uint32 time (ms), int32 payload (g), uint16
+ *                          duration (s), uint8 format (load_log.h: 0 if
+ *                          the weight is the peak, from an older
+ *                          record); then a COMMAND_END reply
+ *   CMD_READ_HISTORY    uint32 first block, uint16 count
+ *                       -> per SD history block still on the card,
+ *                          SD_BLOCK_SIZE / COMMAND_CHUNK replies of
+ *                          uint32 block sequence, uint16 offset, then
+ *                          COMMAND_CHUNK bytes; then a COMMAND_END reply
+ *
+ * Streams (the two READ requests) are sent as fast as the telemetry queue
+ * allows, and requests are read only once the previous one is done.
+ */
+
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include <stdint.h>
+
+#define COMMAND_MAX_PAYLOAD 8
+#define COMMAND_REPLY 0x80
+#define COMMAND_CHUNK 32
+
+enum CommandType {
+  CMD_STATUS = 0x10,
+  CMD_TOTALS = 0x11,
+  CMD_STATS = 0x12,
+  CMD_SET_CALIBRATION = 0x13,
+  CMD_SET_TARGET = 0x14,
+  CMD_SET_CLOCK = 0x15,
+  CMD_TARE = 0x16,
+  CMD_RESET = 0x17,
+  CMD_READ_LOADS = 0x18,
+  CMD_READ_HISTORY = 0x19
+};
+
+enum CommandStatus {
+  COMMAND_OK = 0,
+  COMMAND_END = 1,          // last reply of a stream, no data
+  COMMAND_BUSY = 2,
+  COMMAND_BAD_REQUEST = 3,  // unknown type, wrong length or out of range
+  COMMAND_UNAVAILABLE = 4   // not built in or not working (SD history)
+};
+
+#define COMMAND_FLAG_ZEROED      0x01
+#define COMMAND_FLAG_CALIBRATING 0x02
+#define COMMAND_FLAG_TARING      0x04
+#define COMMAND_FLAG_LOADING     0x08
+#define COMMAND_FLAG_OVERLOAD    0x10
+#define COMMAND_FLAG_FAULT       0x20
+
+class CommandParser {
+public:
+  CommandParser();
+
+  // Returns true when b completes a valid frame, which then stays in
+  // type()/payload()/length() until the next call
+  bool feed(uint8_t b);
+
+  uint8_t type() const { return frameType; }
+  const uint8_t *payload() const { return buf; }
+  uint8_t length() const { return len; }
+
+  uint16_t errors() const { return badFrames; }
+
+private:
+  enum State { WAIT_SYNC, WAIT_LENGTH, WAIT_TYPE, WAIT_PAYLOAD, WAIT_CRC };
+
+  State state;
+  uint8_t frameLen;
+  uint8_t frameType;
+  uint8_t buf[COMMAND_MAX_PAYLOAD];
+  uint8_t len;
+  uint8_t crc;
+  uint16_t badFrames;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "config_store.h"
+#include <EEPROM.h>
+#include "crc8.h"
+#include "eeprom_ring.h"
+
+#if defined(__AVR__)
+#include <avr/eeprom.h>
+#define EEPROM_READY() eeprom_is_ready()
+#else
+#define EEPROM_READY() true
+#endif
+
+ConfigStore::ConfigStore(int baseAddress)
+  : base(baseAddress), current(1), sequence(0), step(CONFIG_WRITE_STEPS) {
+}
+
+bool ConfigStore::begin(DeviceConfig &config) {
+  uint8_t buf[CONFIG_BLOCK_SIZE];
+  bool found = false;
+
+  sequence = 0;
+  current = 1;  // so the first save lands in copy A
+  for (uint8_t copy = 0; copy < 2; copy++) {
+    for (uint8_t i = 0; i < CONFIG_BLOCK_SIZE; i++) {
+      buf[i] = EEPROM.read(copyAddress(copy) + i);
+    }
+    if (crc8(buf, CONFIG_BLOCK_SIZE - 1) != buf[CONFIG_BLOCK_SIZE - 1] || buf[4] != CONFIG_VERSION) {
+      continue;
+    }
+    uint32_t seq = ringReadU32(buf);
+    if (seq <= sequence) {
+      continue;
+    }
+    sequence = seq;
+    current = copy;
+    found = true;
+
+    config.tareChannels = buf[5] <= HX711_MAX_CHANNELS ? buf[5] : 0;
+    config.displayId = buf[6] | (uint16_t) buf[7] << 8;
+    for (uint8_t c = 0; c < HX711_MAX_CHANNELS; c++) {
+      config.calibrationFactor[c] = (int32_t) ringReadU32(buf + 8 + 4 * c);
+      config.tareOffset[c] = (int32_t) ringReadU32(buf + 8 + 4 * HX711_MAX_CHANNELS + 4 * c);
+    }
+    config.targetPayload = (int32_t) ringReadU32(buf + 8 + 8 * HX711_MAX_CHANNELS);
+    config.overloadPercent = buf[12 + 8 * HX711_MAX_CHANNELS];
+  }
+  return found;
+}
+
+void ConfigStore::save(const DeviceConfig &config) {
+  memset(block, 0, sizeof(block));
+  ringWriteU32(block, sequence + 1);
+  block[4] = CONFIG_VERSION;
+  block[5] = config.tareChannels;
+  block[6] = config.displayId & 0xFF;
+  block[7] = config.displayId >> 8;
+  for (uint8_t c = 0; c < HX711_MAX_CHANNELS; c++) {
+    ringWriteU32(block + 8 + 4 * c, config.calibrationFactor[c]);
+    ringWriteU32(block + 8 + 4 * HX711_MAX_CHANNELS + 4 * c, config.tareOffset[c]);
+  }
+  ringWriteU32(block + 8 + 8 * HX711_MAX_CHANNELS, config.targetPayload);
+  block[12 + 8 * HX711_MAX_CHANNELS] = config.overloadPercent;
+  block[CONFIG_BLOCK_SIZE - 1] = crc8(block, CONFIG_BLOCK_SIZE - 1);
+
+  step = 0;
+}
+
+void ConfigStore::service() {
+  if (!busy() || !EEPROM_READY()) {
+    return;
+  }
+
+  // Step 0 invalidates the other copy before any of its bytes change; the
+  // real CRC goes in last
+  uint8_t copy = current ^ 1;
+  int addr = copyAddress(copy);
+  if (step == 0) {
+    EEPROM.update(addr + CONFIG_BLOCK_SIZE - 1, ~block[CONFIG_BLOCK_SIZE - 1]);
+  } else {
+    EEPROM.update(addr + step - 1, block[step - 1]);
+  }
+  step++;
+
+  if (!busy()) {
+    current = copy;
+    sequence++;
+  }
+}
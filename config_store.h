@@ -0,0 +1,73 @@
+/**
+ * Device settings kept as one versioned, CRC-checked block, so boot reads
+ * everything it needs in a single pass.
+ *
+ * Two copies (A and B) alternate: a save goes to the copy not holding the
+ * current settings, tagged with the next sequence number, and boot takes
+ * the newest valid copy. A save interrupted by a power loss leaves the
+ * previous settings intact. Like EEPROMRing, save() only stages the block
+ * and service() writes it one byte per call.
+ *
+ * Block layout (48 bytes, little endian):
+ *   0  uint32 sequence (1 for the first save)
+ *   4  uint8  CONFIG_VERSION
+ *   5  uint8  channels with a saved tare offset (0 if none)
+ *   6  uint16 display controller ID (0 if not known yet)
+ *   8  int32  calibration factor per channel, HX711_MAX_CHANNELS of them
+ *   24 int32  tare offset per channel, HX711_MAX_CHANNELS of them
+ *   40 int32  target payload, grams (0 if none)
+ *   44 uint8  overload alarm margin above the target, percent
+ *   45 reserved, zero
+ *   47 uint8  CRC-8 of bytes 0..46
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+#include "hx711_sampler.h"
+
+#define CONFIG_VERSION 1
+#define CONFIG_BLOCK_SIZE 48
+#define CONFIG_WRITE_STEPS (CONFIG_BLOCK_SIZE + 1)
+
+static_assert(8 + 8 * HX711_MAX_CHANNELS + 5 < CONFIG_BLOCK_SIZE, "config block too small");
+
+struct DeviceConfig {
+  uint16_t displayId;
+  uint8_t tareChannels;
+  int32_t calibrationFactor[HX711_MAX_CHANNELS];
+  int32_t tareOffset[HX711_MAX_CHANNELS];
+  int32_t targetPayload;
+  uint8_t overloadPercent;
+};
+
+class ConfigStore {
+public:
+  // The two copies are CONFIG_BLOCK_SIZE bytes each, from baseAddress
+  ConfigStore(int baseAddress);
+
+  // Load the newest valid copy. Returns false (leaving config untouched)
+  // if neither copy is valid or both are from another version.
+  bool begin(DeviceConfig &config);
+
+  // Stage config for writing. A save still in flight is restarted with
+  // the new settings; the copy it was writing isn't the current one.
+  void save(const DeviceConfig &config);
+
+  // Write the next pending byte, if the EEPROM is ready. Call often.
+  void service();
+  bool busy() const { return step < CONFIG_WRITE_STEPS; }
+
+private:
+  int copyAddress(uint8_t copy) const { return base + copy * CONFIG_BLOCK_SIZE; }
+
+  int base;
+  uint8_t current;    // copy holding the current settings
+  uint32_t sequence;  // sequence number of that copy, 0 if none
+
+  uint8_t block[CONFIG_BLOCK_SIZE];
+  uint8_t step;  // next write step, CONFIG_WRITE_STEPS when idle
+};
+
+#endif
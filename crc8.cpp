@@ -0,0 +1,17 @@
+#include "crc8.h"
+
+uint8_t crc8Update(uint8_t crc, uint8_t data) {
+  crc ^= data;
+  for (uint8_t i = 0; i < 8; i++) {
+    crc = (crc & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+  }
+  return crc;
+}
+
+uint8_t crc8(const uint8_t *data, uint8_t len) {
+  uint8_t crc = CRC8_INIT;
+  while (len--) {
+    crc = crc8Update(crc, *data++);
+  }
+  return crc;
+}
@@ -0,0 +1,18 @@
+/**
+ * CRC-8 (Dallas/Maxim polynomial 0x31, reflected) used to validate EEPROM
+ * records. Bitwise implementation: no lookup table in flash or SRAM.
+ */
+
+#ifndef CRC8_H
+#define CRC8_H
+
+#include <stdint.h>
+
+#define CRC8_INIT 0x00
+
+// Feed one more byte into a running CRC
+uint8_t crc8Update(uint8_t crc, uint8_t data);
+
+uint8_t crc8(const uint8_t *data, uint8_t len);
+
+#endif
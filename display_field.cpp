@@ -0,0 +1,70 @@
+#include "display_field.h"
+
+// Default GFX font cell is 6x8 pixels at text size 1
+#define CHAR_W 6
+#define CHAR_H 8
+
+DisplayField::DisplayField(int16_t x, int16_t y, uint8_t width, uint8_t textSize, uint16_t color, uint16_t background)
+  : x(x), y(y), width(width > DISPLAY_FIELD_MAX_CHARS ? DISPLAY_FIELD_MAX_CHARS : width),
+    textSize(textSize), color(color), background(background), valid(false) {
+  shown[0] = '\0';
+}
+
+void DisplayField::invalidate() {
+  valid = false;
+}
+
+void DisplayField::cleared() {
+  shown[0] = '\0';
+  valid = true;
+}
+
+void DisplayField::show(Adafruit_GFX &gfx, const char *text) {
+  int16_t cellW = CHAR_W * textSize;
+  uint8_t oldLen = valid ? strlen(shown) : width;
+  uint8_t i = 0;
+
+  // Repaint only the cells whose character changed
+  for (; i < width && text[i] != '\0'; i++) {
+    if (valid && i < oldLen && shown[i] == text[i]) {
+      continue;
+    }
+    // drawChar() with the background in the ink colour draws no background
+    gfx.drawChar(x + i * cellW, y, text[i], color, valid && i >= oldLen ? color : background, textSize);
+    shown[i] = text[i];
+  }
+  shown[i] = '\0';
+
+  // Blank whatever the previous, longer text left behind
+  if (i < oldLen) {
+    gfx.fillRect(x + i * cellW, y, (oldLen - i) * cellW, CHAR_H * textSize, background);
+  }
+
+  valid = true;
+}
+
+uint8_t formatDecimal(char *buf, long value, uint8_t decimals) {
+  char digits[12];
+  uint8_t n = 0;
+  bool negative = value < 0;
+  unsigned long v = negative ? 0UL - (unsigned long) value : (unsigned long) value;
+
+  // Generate digits least significant first, with at least one before the point
+  do {
+    digits[n++] = '0' + (v % 10);
+    v /= 10;
+  } while (v != 0 || n <= decimals);
+
+  uint8_t len = 0;
+  if (negative) {
+    buf[len++] = '-';
+  }
+  while (n > 0) {
+    if (n == decimals) {
+      buf[len++] = '.';
+    }
+    buf[len++] = digits[--n];
+  }
+  buf[len] = '\0';
+  return len;
+}
@@ -0,0 +1,51 @@
+/**
+ * Retained-mode text field for the TFT.
+ *
+ * A DisplayField remembers the text it last rendered and, on show(), only
+ * repaints the character cells that differ. Glyphs are drawn opaque (with a
+ * background colour) so a changed cell never needs a separate clear, and
+ * cells left over from a longer previous string are blanked with one
+ * fillRect. Unchanged values cost a short string compare and no bus traffic.
+ * A cell known to be blank (past the end of the text shown, or the whole
+ * field after cleared()) only gets the glyph's own pixels.
+ */
+
+#ifndef DISPLAY_FIELD_H
+#define DISPLAY_FIELD_H
+
+#include <Adafruit_GFX.h>
+
+// Longest text a field can hold
+#define DISPLAY_FIELD_MAX_CHARS 12
+
+class DisplayField {
+public:
+  // width is the number of character cells the field owns on screen
+  DisplayField(int16_t x, int16_t y, uint8_t width, uint8_t textSize, uint16_t color, uint16_t background);
+
+  // Forget what is on screen, e.g. after the area was cleared or
+  // overdrawn; the next show() repaints the whole field.
+  void invalidate();
+
+  // The area has just been cleared to the background colour, so the next
+  // show() can skip the glyphs' background pixels
+  void cleared();
+
+  void show(Adafruit_GFX &gfx, const char *text);
+
+private:
+  int16_t x;
+  int16_t y;
+  uint8_t width;
+  uint8_t textSize;
+  uint16_t color;
+  uint16_t background;
+  bool valid;
+  char shown[DISPLAY_FIELD_MAX_CHARS + 1];
+};
+
+// Format value / 10^decimals as fixed-point decimal text into buf
+// (e.g. 1234, 1 -> "123.4"). Returns the number of characters written.
+uint8_t formatDecimal(char *buf, long value, uint8_t decimals);
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * Map of the Uno's 1 KB EEPROM. Every persistent structure owns one region;
+ * keep the regions in address order and make sure they don't overlap.
+ */
+
+#ifndef EEPROM_LAYOUT_H
+#define EEPROM_LAYOUT_H
+
+// Legacy settings (0x000 - 0x03F), only read to migrate them to the
+// journal and the config block. The first firmware kept floats:
+#define EEPROM_FLOAT_COUNT_ADDR     0       // int16 load count
+#define EEPROM_FLOAT_TOTAL_ADDR     2       // float total (kg)
+#define EEPROM_FLOAT_CAL_ADDR       6       // float counts per kg
+// then scaled integers, as in weight_units.h:
+#define EEPROM_LOAD_COUNT_ADDR      10      // int16 load count
+#define EEPROM_TOTAL_WEIGHT_ADDR    12      // int64 total (g)
+#define EEPROM_CAL_FACTOR_ADDR      20      // 4 bytes per HX711 channel, 20 to 35
+
+// Load count / total weight journal (0x040 - 0x16F)
+#define EEPROM_JOURNAL_ADDR         0x040
+#define EEPROM_JOURNAL_SLOTS        19      // 16-byte records
+
+// Multi-point calibration curve, copy A (0x170 - 0x1BD); copy B is at
+// the end, where the space for both doesn't fit
+#define EEPROM_CAL_CURVE_A_ADDR     0x170   // 78 bytes
+
+// Per-load event log (0x1C0 - 0x2BF)
+#define EEPROM_LOAD_LOG_ADDR        0x1C0
+#define EEPROM_LOAD_LOG_SLOTS       16      // 16-byte records
+
+// Shift and day statistics, A and B copies (0x2C0 - 0x33F)
+#define EEPROM_STATS_ADDR           0x2C0   // 2 x 64 bytes
+
+// Device config block, A and B copies (0x340 - 0x39F)
+#define EEPROM_CONFIG_ADDR          0x340   // 2 x 48 bytes
+
+// Multi-point calibration curve, copy B (0x3A0 - 0x3ED)
+#define EEPROM_CAL_CURVE_B_ADDR     0x3A0   // 78 bytes
+
+#endif
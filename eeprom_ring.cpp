@@ -0,0 +1,102 @@
+#include "eeprom_ring.h"
+#include <EEPROM.h>
+#include "crc8.h"
+
+#if defined(__AVR__)
+#include <avr/eeprom.h>
+#define EEPROM_READY() eeprom_is_ready()
+#else
+#define EEPROM_READY() true
+#endif
+
+uint32_t ringReadU32(const uint8_t *p) {
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+void ringWriteU32(uint8_t *p, uint32_t v) {
+  for (uint8_t i = 0; i < 4; i++) {
+    p[i] = v >> (8 * i);
+  }
+}
+
+EEPROMRing::EEPROMRing(int baseAddress, uint8_t slots)
+  : base(baseAddress), slots(slots), newestSlot(slots - 1), newest(0), step(EEPROM_RING_WRITE_STEPS) {
+}
+
+bool EEPROMRing::readSlot(uint8_t slot, uint8_t *buf) const {
+  for (uint8_t i = 0; i < EEPROM_RING_RECORD_SIZE; i++) {
+    buf[i] = EEPROM.read(slotAddress(slot) + i);
+  }
+  return crc8(buf, EEPROM_RING_RECORD_SIZE - 1) == buf[EEPROM_RING_RECORD_SIZE - 1];
+}
+
+bool EEPROMRing::begin() {
+  uint8_t buf[EEPROM_RING_RECORD_SIZE];
+
+  newest = 0;
+  newestSlot = slots - 1;  // so the first append lands in slot 0
+  for (uint8_t slot = 0; slot < slots; slot++) {
+    if (!readSlot(slot, buf)) {
+      continue;
+    }
+    uint32_t seq = ringReadU32(buf);
+    if (seq > newest) {
+      newest = seq;
+      newestSlot = slot;
+    }
+  }
+  return newest != 0;
+}
+
+bool EEPROMRing::append(const uint8_t *payload) {
+  if (busy()) {
+    return false;
+  }
+
+  ringWriteU32(record, newest + 1);
+  memcpy(record + 4, payload, EEPROM_RING_PAYLOAD);
+  record[EEPROM_RING_RECORD_SIZE - 1] = crc8(record, EEPROM_RING_RECORD_SIZE - 1);
+
+  step = 0;
+  return true;
+}
+
+void EEPROMRing::service() {
+  if (!busy() || !EEPROM_READY()) {
+    return;
+  }
+
+  // Step 0 invalidates the old record in the slot before any of its bytes
+  // change; the real CRC goes in last
+  uint8_t slot = (newestSlot + 1) % slots;
+  int addr = slotAddress(slot);
+  if (step == 0) {
+    EEPROM.update(addr + EEPROM_RING_RECORD_SIZE - 1, ~record[EEPROM_RING_RECORD_SIZE - 1]);
+  } else {
+    EEPROM.update(addr + step - 1, record[step - 1]);
+  }
+  step++;
+
+  if (!busy()) {
+    newestSlot = slot;
+    newest++;
+  }
+}
+
+bool EEPROMRing::read(uint32_t sequence, uint8_t *payload) const {
+  if (sequence == 0 || sequence > newest || sequence < oldestSequence()) {
+    return false;
+  }
+
+  // Records are written to consecutive slots, so the slot follows from the
+  // distance to the newest record
+  uint8_t back = (newest - sequence) % slots;
+  uint8_t slot = (newestSlot + slots - back) % slots;
+
+  uint8_t buf[EEPROM_RING_RECORD_SIZE];
+  if (!readSlot(slot, buf) || ringReadU32(buf) != sequence) {
+    return false;
+  }
+  memcpy(payload, buf + 4, EEPROM_RING_PAYLOAD);
+  return true;
+}
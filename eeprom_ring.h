@@ -0,0 +1,72 @@
+/**
+ * Circular, wear-leveled store of fixed-size EEPROM records.
+ *
+ * Every append goes to the next slot of the region, tagged with an
+ * increasing sequence number and a CRC, so wear is spread evenly and the
+ * newest record is found at boot by scanning for the highest valid
+ * sequence. A record interrupted by a power loss only costs that record.
+ *
+ * Writes are incremental: append() stages a record and service() writes it
+ * one byte per call, only when the EEPROM has finished the previous byte,
+ * so nobody ever waits the ~3.3 ms a byte write takes. The slot's old CRC
+ * is invalidated first and the new CRC byte written last, so a record is
+ * only ever valid once it is complete.
+ *
+ * Record layout (16 bytes, little endian):
+ *   0  uint32 sequence (1 for the first record)
+ *   4  payload, EEPROM_RING_PAYLOAD bytes
+ *   15 uint8  CRC-8 of bytes 0..14
+ */
+
+#ifndef EEPROM_RING_H
+#define EEPROM_RING_H
+
+#include <Arduino.h>
+
+#define EEPROM_RING_RECORD_SIZE 16
+#define EEPROM_RING_PAYLOAD 11
+#define EEPROM_RING_WRITE_STEPS (EEPROM_RING_RECORD_SIZE + 1)
+
+class EEPROMRing {
+public:
+  EEPROMRing(int baseAddress, uint8_t slots);
+
+  // Scan the region for the newest valid record. Returns false if the
+  // region holds no valid record at all.
+  bool begin();
+
+  // Stage a record for writing. Returns false if the previous record is
+  // still being written; try again once busy() is false.
+  bool append(const uint8_t *payload);
+
+  // Write the next pending byte, if the EEPROM is ready. Call often.
+  void service();
+  bool busy() const { return step < EEPROM_RING_WRITE_STEPS; }
+
+  // Sequence numbers of the records still held (oldest > newest if empty).
+  // A record being written counts once it is complete.
+  uint32_t newestSequence() const { return newest; }
+  uint32_t oldestSequence() const { return newest >= slots ? newest - slots + 1 : 1; }
+
+  // Read the payload of one record straight from EEPROM. Returns false if
+  // it has been overwritten, was never written or fails its CRC.
+  bool read(uint32_t sequence, uint8_t *payload) const;
+
+private:
+  int slotAddress(uint8_t slot) const { return base + slot * EEPROM_RING_RECORD_SIZE; }
+  bool readSlot(uint8_t slot, uint8_t *record) const;
+
+  int base;
+  uint8_t slots;
+  uint8_t newestSlot;
+  uint32_t newest;
+
+  uint8_t record[EEPROM_RING_RECORD_SIZE];
+  uint8_t step;  // next write step, EEPROM_RING_WRITE_STEPS when idle
+};
+
+// Little-endian helpers for packing payloads
+uint32_t ringReadU32(const uint8_t *p);
+void ringWriteU32(uint8_t *p, uint32_t v);
+
+#endif
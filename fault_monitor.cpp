@@ -0,0 +1,131 @@
+#include "fault_monitor.h"
+#include "weight_units.h"
+
+FaultMonitor::FaultMonitor(uint8_t alarmPin)
+  : pin(alarmPin), channels(0), limit(0), bits(0), channelBits(0), frames(0), overload(false),
+    driven(false), framesSeen(0), frameSeenAt(0) {
+  memset(tare, 0, sizeof(tare));
+  memset(gain, 0, sizeof(gain));
+  memset(last, 0, sizeof(last));
+  memset(saturatedRun, 0, sizeof(saturatedRun));
+  memset(stuckRun, 0, sizeof(stuckRun));
+}
+
+void FaultMonitor::begin(uint8_t count) {
+  channels = count > HX711_MAX_CHANNELS ? HX711_MAX_CHANNELS : count;
+#if defined(__AVR__)
+  if (MCUSR & bit(WDRF)) {
+    bits |= FAULT_WATCHDOG_RESET;
+  }
+  MCUSR = 0;
+  wdt_disable();
+#endif
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+  frameSeenAt = millis();
+}
+
+void FaultMonitor::startWatchdog() {
+#if defined(__AVR__)
+  wdt_enable(FAULT_WATCHDOG_TIMEOUT);
+#endif
+}
+
+void FaultMonitor::kick() {
+#if defined(__AVR__)
+  wdt_reset();
+#endif
+}
+
+void FaultMonitor::setAlarm(const int32_t *tareOffsets, const int64_t *gramsPerCount, int32_t limitGrams) {
+  noInterrupts();
+  for (uint8_t c = 0; c < channels; c++) {
+    tare[c] = tareOffsets[c];
+    gain[c] = gramsPerCount[c];
+  }
+  limit = limitGrams;
+  if (limit <= 0) {
+    overload = false;
+  }
+  drive();
+  interrupts();
+}
+
+// Runs with interrupts disabled, straight after the frame is clocked out
+void FaultMonitor::frame(const HX711Frame &f) {
+  uint8_t saturated = 0;
+  uint8_t stuck = 0;
+  int32_t gross = 0;
+  for (uint8_t c = 0; c < channels; c++) {
+    int32_t raw = f.raw[c];
+    if (raw >= FAULT_RAW_LIMIT || raw <= -FAULT_RAW_LIMIT) {
+      if (saturatedRun[c] < FAULT_SATURATED_FRAMES) {
+        saturatedRun[c]++;
+      }
+    } else {
+      saturatedRun[c] = 0;
+    }
+    if (raw == last[c]) {
+      if (stuckRun[c] < FAULT_STUCK_FRAMES) {
+        stuckRun[c]++;
+      }
+    } else {
+      stuckRun[c] = 0;
+    }
+    last[c] = raw;
+    if (saturatedRun[c] >= FAULT_SATURATED_FRAMES) {
+      saturated |= 1 << c;
+    }
+    if (stuckRun[c] >= FAULT_STUCK_FRAMES) {
+      stuck |= 1 << c;
+    }
+    gross += countsToGrams(raw - tare[c], gain[c]);
+  }
+
+  uint8_t b = bits & ~(FAULT_SATURATED | FAULT_STUCK | FAULT_ADC_TIMEOUT);
+  if (saturated) {
+    b |= FAULT_SATURATED;
+  }
+  if (stuck) {
+    b |= FAULT_STUCK;
+  }
+  bits = b;
+  channelBits = saturated | stuck;
+  frames++;
+
+  if (limit > 0) {
+    if (gross > limit) {
+      overload = true;
+    } else if (gross < limit - FAULT_ALARM_HYSTERESIS) {
+      overload = false;
+    }
+  }
+  drive();
+}
+
+bool FaultMonitor::check(unsigned long now) {
+  uint8_t n = frames;
+  if (n != framesSeen) {
+    framesSeen = n;
+    frameSeenAt = now;
+    return false;
+  }
+  if (now - frameSeenAt < FAULT_ADC_TIMEOUT_MS) {
+    return false;
+  }
+  frameSeenAt = now;
+  noInterrupts();
+  bits |= FAULT_ADC_TIMEOUT;
+  drive();
+  interrupts();
+  return true;
+}
+
+// Only changes are written, to keep the interrupt short
+void FaultMonitor::drive() {
+  bool on = overload || (bits & (FAULT_ADC_TIMEOUT | FAULT_SATURATED));
+  if (on != driven) {
+    driven = on;
+    digitalWrite(pin, on ? HIGH : LOW);
+  }
+}
@@ -0,0 +1,108 @@
+/**
+ * Sensor fault detection and the overload output.
+ *
+ * frame() is hooked into the sampler (HX711Sampler::setFrameHook), so it
+ * sees every frame as soon as it is clocked out, in interrupt context,
+ * before the queue and loop() are involved at all:
+ *
+ *   - a channel at or beyond FAULT_RAW_LIMIT for FAULT_SATURATED_FRAMES
+ *     frames in a row is saturated (overloaded cell, open bridge wire)
+ *   - a channel returning the exact same 24-bit count for
+ *     FAULT_STUCK_FRAMES frames in a row is stuck (a live ADC always has
+ *     a few counts of noise; a dead HX711 holding DOUT low reads a
+ *     constant)
+ *   - the tared gross weight is compared with the overload limit and the
+ *     alarm pin is driven on the same frame that crosses it. It uses the
+ *     linear calibration and no filtering, so the latency is one
+ *     conversion; it is released FAULT_ALARM_HYSTERESIS grams below.
+ *
+ * check() runs from loop() and flags an ADC timeout when no frame has
+ * arrived for FAULT_ADC_TIMEOUT_MS (a disconnected HX711 never pulls DOUT
+ * low, and with a shared SCK one such channel stalls all of them). The
+ * alarm pin is also driven while a timeout or saturation is flagged: the
+ * scale cannot tell whether it is overloaded then.
+ *
+ * On AVR the monitor also owns the hardware watchdog: startWatchdog() once
+ * setup() is done, kick() every scheduler pass, so a hung task (or
+ * display) resets the board after FAULT_WATCHDOG_TIMEOUT. begin() records
+ * whether the last reset came from it.
+ */
+
+#ifndef FAULT_MONITOR_H
+#define FAULT_MONITOR_H
+
+#include <Arduino.h>
+#include "hx711_sampler.h"
+#if defined(__AVR__)
+#include <avr/wdt.h>
+#endif
+
+// Near the ends of the 24-bit range, where the HX711 clamps
+#define FAULT_RAW_LIMIT        8300000L
+#define FAULT_SATURATED_FRAMES 8
+#define FAULT_STUCK_FRAMES     40     // 0.5 s at 80 SPS
+#define FAULT_ADC_TIMEOUT_MS   500    // 5 periods at 10 SPS
+#define FAULT_ALARM_HYSTERESIS 100000L  // grams
+#if defined(__AVR__)
+#define FAULT_WATCHDOG_TIMEOUT WDTO_2S
+#endif
+
+// faults() bits
+#define FAULT_ADC_TIMEOUT     0x01
+#define FAULT_SATURATED       0x02
+#define FAULT_STUCK           0x04
+#define FAULT_WATCHDOG_RESET  0x08  // since power-up, not cleared
+
+class FaultMonitor {
+public:
+  explicit FaultMonitor(uint8_t alarmPin);
+
+  // First thing in setup(): a watchdog reset leaves the watchdog running
+  void begin(uint8_t channels);
+  void startWatchdog();
+  void kick();
+
+  // Tare offsets (counts), Q24 gains as in weight_units.h and the limit
+  // in grams (0 = no overload alarm). Copied, so they can change under
+  // the interrupt.
+  void setAlarm(const int32_t *tare, const int64_t *gramsPerCount, int32_t limit);
+
+  // Sampler frame hook (interrupt context)
+  void frame(const HX711Frame &frame);
+
+  // From loop(). Returns true once per FAULT_ADC_TIMEOUT_MS without frames,
+  // when the sampler should be restarted.
+  bool check(unsigned long now);
+
+  // The HX711s were powered down on purpose: time the next frame from now
+  void expectFrames(unsigned long now) { frameSeenAt = now; }
+
+  uint8_t faults() const { return bits; }
+  uint8_t faultChannels() const { return channelBits; }  // bit c: channel c
+  bool cellFault() const { return bits & (FAULT_SATURATED | FAULT_STUCK); }
+  bool alarmed() const { return overload; }
+
+private:
+  void drive();
+
+  uint8_t pin;
+  uint8_t channels;
+  int32_t tare[HX711_MAX_CHANNELS];
+  int64_t gain[HX711_MAX_CHANNELS];
+  int32_t limit;
+
+  // Written by frame()
+  volatile uint8_t bits;
+  volatile uint8_t channelBits;
+  volatile uint8_t frames;
+  volatile bool overload;
+  bool driven;  // alarm pin level
+  int32_t last[HX711_MAX_CHANNELS];
+  uint8_t saturatedRun[HX711_MAX_CHANNELS];
+  uint8_t stuckRun[HX711_MAX_CHANNELS];
+
+  uint8_t framesSeen;
+  unsigned long frameSeenAt;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "flow_rate.h"
+
+#define FIT_N ((int64_t) FLOW_RATE_POINTS)
+#define SUM_I (FIT_N * (FIT_N - 1) / 2)
+#define FIT_DENOMINATOR (FIT_N * FIT_N * (FIT_N * FIT_N - 1) / 12)  // N sum(i^2) - sum(i)^2
+
+FlowRateEstimator::FlowRateEstimator() {
+  reset();
+}
+
+void FlowRateEstimator::reset() {
+  blockSum = 0;
+  blockCount = 0;
+  oldest = 0;
+  filled = 0;
+  sumY = 0;
+  sumIY = 0;
+}
+
+void FlowRateEstimator::update(int32_t grams, unsigned long now) {
+  blockSum += grams;
+  if (++blockCount < FLOW_RATE_DECIMATION) {
+    return;
+  }
+  push(blockSum / FLOW_RATE_DECIMATION, (uint16_t) now);
+  blockSum = 0;
+  blockCount = 0;
+}
+
+void FlowRateEstimator::push(int32_t y, uint16_t stamp) {
+  if (filled < FLOW_RATE_POINTS) {
+    sumIY += (int64_t) filled * y;
+    sumY += y;
+    points[filled] = y;
+    stamps[filled] = stamp;
+    filled++;
+    return;
+  }
+
+  // Every point moves one place older; the oldest drops out
+  int32_t y0 = points[oldest];
+  sumIY += (FIT_N - 1) * y - (sumY - y0);
+  sumY += y - y0;
+  points[oldest] = y;
+  stamps[oldest] = stamp;
+  oldest = (oldest + 1) % FLOW_RATE_POINTS;
+}
+
+int32_t FlowRateEstimator::rate() const {
+  if (!ready()) {
+    return 0;
+  }
+
+  // Slope in grams per point, scaled by the points per second the window
+  // actually took
+  uint8_t newest = (oldest + FLOW_RATE_POINTS - 1) % FLOW_RATE_POINTS;
+  uint16_t spanMs = stamps[newest] - stamps[oldest];
+  if (spanMs == 0) {
+    return 0;
+  }
+  int64_t numerator = (FIT_N * sumIY - SUM_I * sumY) * (FIT_N - 1) * 1000;
+  return numerator / (FIT_DENOMINATOR * spanMs);
+}
+
+long FlowRateEstimator::timeTo(int32_t target, int32_t current) const {
+  int32_t r = rate();
+  if (r <= 0 || current >= target) {
+    return -1;
+  }
+  return ((int64_t) target - current) / r;
+}
@@ -0,0 +1,60 @@
+/**
+ * Loading rate estimator: the slope of a least-squares line through the
+ * last few seconds of the filtered weight stream.
+ *
+ * Samples are averaged in blocks of FLOW_RATE_DECIMATION into points, and
+ * the fit runs over the last FLOW_RATE_POINTS points. With the points
+ * numbered 0..N-1 oldest first, sum(i) and sum(i^2) are constants and
+ * sum(y) and sum(i*y) slide exactly (integer arithmetic, no drift):
+ *
+ *   sum(i*y)' = sum(i*y) - (sum(y) - y_oldest) + (N-1) * y_new
+ *
+ * so each sample costs an add, and each point a handful more. The one
+ * division happens in rate(), which is only called to display the result.
+ * Point timestamps give the real time span of the window, whatever the
+ * HX711 data rate.
+ */
+
+#ifndef FLOW_RATE_H
+#define FLOW_RATE_H
+
+#include <Arduino.h>
+
+#define FLOW_RATE_DECIMATION 8   // samples per point (100 ms at 80 SPS)
+#define FLOW_RATE_POINTS     32  // points in the fit (3.2 s at 80 SPS)
+
+class FlowRateEstimator {
+public:
+  FlowRateEstimator();
+
+  // Start over, e.g. after a tare
+  void reset();
+
+  // Feed one filtered weight sample (grams) taken at now (ms)
+  void update(int32_t grams, unsigned long now);
+
+  // True once the window is full
+  bool ready() const { return filled == FLOW_RATE_POINTS; }
+
+  // Loading rate in grams per second, 0 until ready()
+  int32_t rate() const;
+
+  // Seconds until current reaches target at the present rate, or -1 if
+  // it isn't getting there (or already has)
+  long timeTo(int32_t target, int32_t current) const;
+
+private:
+  void push(int32_t y, uint16_t stamp);
+
+  int32_t blockSum;
+  uint8_t blockCount;
+
+  int32_t points[FLOW_RATE_POINTS];
+  uint16_t stamps[FLOW_RATE_POINTS];  // low 16 bits of millis()
+  uint8_t oldest;
+  uint8_t filled;
+  int64_t sumY;
+  int64_t sumIY;
+};
+
+#endif
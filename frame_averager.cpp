@@ -0,0 +1,37 @@
+#include "frame_averager.h"
+
+FrameAverager::FrameAverager() : channels(0), count(0), target(0) {
+}
+
+void FrameAverager::start(uint8_t channelCount, uint8_t times) {
+  channels = channelCount > HX711_MAX_CHANNELS ? HX711_MAX_CHANNELS : channelCount;
+  target = times > FRAME_AVERAGE_MAX ? FRAME_AVERAGE_MAX : times;
+  count = 0;
+  memset(sum, 0, sizeof(sum));
+}
+
+void FrameAverager::cancel() {
+  target = 0;
+  count = 0;
+}
+
+bool FrameAverager::add(const HX711Frame &frame) {
+  if (!active()) {
+    return false;
+  }
+  for (uint8_t c = 0; c < channels; c++) {
+    sum[c] += frame.raw[c];
+  }
+  return ++count >= target;
+}
+
+uint8_t FrameAverager::progress() const {
+  return target ? (uint16_t) count * 100 / target : 0;
+}
+
+void FrameAverager::take(HX711Frame &average) {
+  for (uint8_t c = 0; c < HX711_MAX_CHANNELS; c++) {
+    average.raw[c] = c < channels && count ? sum[c] / count : 0;
+  }
+  cancel();
+}
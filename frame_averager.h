@@ -0,0 +1,47 @@
+/**
+ * Background per-channel averaging of HX711 frames.
+ *
+ * Tare and calibration need the mean of several conversions. Rather than
+ * waiting for them in a loop, the sketch starts an averager and feeds it
+ * the frames it drains from the sampler anyway; add() reports when the
+ * window is complete. The UI keeps running meanwhile and can show
+ * progress() or cancel() the measurement.
+ */
+
+#ifndef FRAME_AVERAGER_H
+#define FRAME_AVERAGER_H
+
+#include <Arduino.h>
+#include "hx711_sampler.h"
+
+// Longest window: 24-bit counts summed this many times still fit in int32
+#define FRAME_AVERAGE_MAX 128
+
+class FrameAverager {
+public:
+  FrameAverager();
+
+  // Begin a new window of `times` frames over `channels` channels,
+  // discarding any measurement in progress.
+  void start(uint8_t channels, uint8_t times);
+  void cancel();
+
+  bool active() const { return target > 0 && count < target; }
+  bool done() const { return target > 0 && count >= target; }
+
+  // Add one frame. Returns true on the frame that completes the window.
+  bool add(const HX711Frame &frame);
+
+  uint8_t progress() const;  // percent
+
+  // Mean of each channel once done(); also ends the measurement.
+  void take(HX711Frame &average);
+
+private:
+  int32_t sum[HX711_MAX_CHANNELS];
+  uint8_t channels;
+  uint8_t count;
+  uint8_t target;
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "hx711_sampler.h"
+
+HX711Sampler *HX711Sampler::instance = 0;
+
+HX711Sampler::HX711Sampler()
+  : dropped(0), frameHook(0), channels(0), sckPin(0), gainPulses(1), irq(-1), isRunning(false) {
+}
+
+void HX711Sampler::begin(const uint8_t *douts, uint8_t count, uint8_t sck, uint8_t gain) {
+  channels = count > HX711_MAX_CHANNELS ? HX711_MAX_CHANNELS : count;
+  sckPin = sck;
+
+  // Extra pulses after the 24 data bits select the gain of the next conversion
+  switch (gain) {
+    case 64:  gainPulses = 3; break;
+    case 32:  gainPulses = 2; break;
+    default:  gainPulses = 1; break;  // 128
+  }
+
+  pinMode(sckPin, OUTPUT);
+  digitalWrite(sckPin, LOW);
+#if defined(__AVR__)
+  sckOut = portOutputRegister(digitalPinToPort(sckPin));
+  sckMask = digitalPinToBitMask(sckPin);
+#endif
+
+  for (uint8_t c = 0; c < channels; c++) {
+    doutPins[c] = douts[c];
+    pinMode(doutPins[c], INPUT);
+#if defined(__AVR__)
+    doutIn[c] = portInputRegister(digitalPinToPort(doutPins[c]));
+    doutMask[c] = digitalPinToBitMask(doutPins[c]);
+#endif
+  }
+
+  // The first channel's data-ready edge drives the interrupt
+  irq = channels > 0 ? digitalPinToInterrupt(doutPins[0]) : -1;
+  instance = this;
+}
+
+void HX711Sampler::start() {
+  if (isRunning || channels == 0) {
+    return;
+  }
+  isRunning = true;
+  if (irq >= 0) {
+    attachInterrupt(irq, onDataReady, FALLING);
+  }
+  // A conversion that completed before the interrupt was armed produces no
+  // edge; collect it now or the HX711 would wait for us forever.
+  noInterrupts();
+  clockOut();
+  interrupts();
+}
+
+void HX711Sampler::stop() {
+  if (!isRunning) {
+    return;
+  }
+  if (irq >= 0) {
+    detachInterrupt(irq);
+  }
+  isRunning = false;
+}
+
+void HX711Sampler::powerDown() {
+  stop();
+  digitalWrite(sckPin, HIGH);
+}
+
+void HX711Sampler::powerUp() {
+  digitalWrite(sckPin, LOW);
+  start();
+}
+
+void HX711Sampler::poll() {
+  // With one channel on an interrupt pin the ISR never misses a frame
+  if (!isRunning || (irq >= 0 && channels == 1)) {
+    return;
+  }
+  noInterrupts();
+  clockOut();
+  interrupts();
+}
+
+void HX711Sampler::onDataReady() {
+  if (instance) {
+    instance->clockOut();
+  }
+}
+
+bool HX711Sampler::allReady() const {
+  for (uint8_t c = 0; c < channels; c++) {
+#if defined(__AVR__)
+    if (*doutIn[c] & doutMask[c]) {
+      return false;
+    }
+#else
+    if (digitalRead(doutPins[c]) != LOW) {
+      return false;
+    }
+#endif
+  }
+  return true;
+}
+
+// Runs with interrupts disabled: the HX711 enters power-down if SCK stays
+// high for more than 60 us, so the pulse train must not be preempted.
+void HX711Sampler::clockOut() {
+  // Bit toggling on DOUT while we clock also triggers INT, and with shared
+  // SCK every channel must be ready before any of them is clocked
+  if (!allReady()) {
+    return;
+  }
+
+  uint32_t value[HX711_MAX_CHANNELS] = { 0 };
+
+#if defined(__AVR__)
+  for (uint8_t i = 0; i < 24; i++) {
+    *sckOut |= sckMask;
+    // The shifts also cover the 0.2 us minimum SCK high time
+    for (uint8_t c = 0; c < channels; c++) {
+      value[c] <<= 1;
+      if (*doutIn[c] & doutMask[c]) {
+        value[c] |= 1;
+      }
+    }
+    *sckOut &= ~sckMask;
+  }
+  for (uint8_t i = 0; i < gainPulses; i++) {
+    *sckOut |= sckMask;
+    __asm__ __volatile__("nop\n\tnop\n\t");
+    *sckOut &= ~sckMask;
+  }
+#ifdef EIFR
+  // Drop the edges DOUT produced while shifting out the data
+  if (irq >= 0) {
+    EIFR = bit(irq);
+  }
+#endif
+#else
+  for (uint8_t i = 0; i < 24; i++) {
+    digitalWrite(sckPin, HIGH);
+    for (uint8_t c = 0; c < channels; c++) {
+      value[c] <<= 1;
+      if (digitalRead(doutPins[c]) == HIGH) {
+        value[c] |= 1;
+      }
+    }
+    digitalWrite(sckPin, LOW);
+  }
+  for (uint8_t i = 0; i < gainPulses; i++) {
+    digitalWrite(sckPin, HIGH);
+    digitalWrite(sckPin, LOW);
+  }
+#endif
+
+  // Sign-extend the 24-bit two's complement results
+  HX711Frame frame;
+  for (uint8_t c = 0; c < HX711_MAX_CHANNELS; c++) {
+    if (value[c] & 0x800000UL) {
+      value[c] |= 0xFF000000UL;
+    }
+    frame.raw[c] = (int32_t) value[c];
+  }
+
+  if (frameHook) {
+    frameHook(frame);
+  }
+  if (!queue.push(frame)) {
+    dropped++;
+  }
+}
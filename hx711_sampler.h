@@ -0,0 +1,109 @@
+/**
+ * Interrupt-driven HX711 sampling engine.
+ *
+ * The HX711 pulls DOUT low when a conversion is ready. Instead of spinning on
+ * that line (as HX711::read() does), the sampler attaches an interrupt to the
+ * DOUT falling edge, clocks the 24 data bits plus the gain-select pulses out
+ * inside the ISR and pushes the raw, sign-extended count into a lock-free
+ * queue that loop() drains with read().
+ *
+ * Several HX711s (one per load cell) can share a single SCK line, each on
+ * its own DOUT pin. All of them are clocked out together in one 24-pulse
+ * pass, reading every DOUT on each pulse, so a frame holds one conversion
+ * from each channel taken at the same moment. Because SCK is shared, a
+ * frame is only read once every channel has a conversion ready: the first
+ * channel's edge triggers the interrupt, and if another channel is still
+ * converting poll() collects the frame as soon as it is.
+ *
+ * An optional frame hook sees each frame as it is clocked out, before it
+ * is queued, still with interrupts disabled: for checks that cannot wait
+ * for loop(). It must be short.
+ *
+ * On the Uno only pins 2 and 3 have external interrupts; if the first DOUT
+ * is wired to another pin the sampler falls back to non-blocking polling
+ * from poll().
+ */
+
+#ifndef HX711_SAMPLER_H
+#define HX711_SAMPLER_H
+
+#include <Arduino.h>
+#include "ring_buffer.h"
+
+// Most HX711s that can share one SCK line
+#ifndef HX711_MAX_CHANNELS
+#define HX711_MAX_CHANNELS 4
+#endif
+
+// Frames buffered between the ISR and loop(). At 80 SPS this covers
+// ~90 ms of loop() latency before frames are dropped.
+#define HX711_QUEUE_SIZE 8
+
+// One conversion from each channel, raw and sign-extended
+struct HX711Frame {
+  int32_t raw[HX711_MAX_CHANNELS];
+};
+
+typedef void (*HX711FrameHook)(const HX711Frame &frame);
+
+class HX711Sampler {
+public:
+  HX711Sampler();
+
+  // gain: 128 or 64 (channel A) or 32 (channel B), as in the HX711 library.
+  // All channels use the same gain since they share the gain-select pulses.
+  void begin(const uint8_t *douts, uint8_t channels, uint8_t sck, uint8_t gain = 128);
+  void begin(uint8_t dout, uint8_t sck, uint8_t gain = 128) { begin(&dout, 1, sck, gain); }
+
+  void setFrameHook(HX711FrameHook hook) { frameHook = hook; }
+
+  // Enable / disable sampling.
+  void start();
+  void stop();
+  bool running() const { return isRunning; }
+
+  // Stop and hold SCK high, which puts the HX711s in power-down after
+  // 60 us; powerUp() wakes them, and the first conversion comes once they
+  // have settled (50 ms at 80 SPS, 400 ms at 10 SPS).
+  void powerDown();
+  void powerUp();
+
+  // Call from loop(). Collects frames the interrupt could not (DOUT not on
+  // an interrupt pin, or another channel not ready yet); cheap otherwise.
+  void poll();
+
+  // Pop the oldest frame. Returns false when none is pending.
+  bool read(HX711Frame &frame) { return queue.pop(frame); }
+  bool available() const { return !queue.empty(); }
+
+  uint8_t channelCount() const { return channels; }
+
+  // Frames lost because loop() did not drain the queue in time.
+  uint16_t droppedSamples() const { return dropped; }
+
+private:
+  static void onDataReady();
+  bool allReady() const;
+  void clockOut();
+
+  static HX711Sampler *instance;
+
+  RingBuffer<HX711Frame, HX711_QUEUE_SIZE> queue;
+  volatile uint16_t dropped;
+  HX711FrameHook frameHook;
+  uint8_t doutPins[HX711_MAX_CHANNELS];
+  uint8_t channels;
+  uint8_t sckPin;
+  uint8_t gainPulses;
+  int8_t irq;
+  bool isRunning;
+
+#if defined(__AVR__)
+  volatile uint8_t *sckOut;
+  volatile uint8_t *doutIn[HX711_MAX_CHANNELS];
+  uint8_t sckMask;
+  uint8_t doutMask[HX711_MAX_CHANNELS];
+#endif
+};
+
+#endif
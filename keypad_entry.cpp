@@ -0,0 +1,59 @@
+#include "keypad_entry.h"
+
+KeypadEntry::KeypadEntry() {
+  clear();
+}
+
+void KeypadEntry::clear() {
+  len = 0;
+  point = -1;
+  buf[0] = '\0';
+}
+
+bool KeypadEntry::press(char key) {
+  if (key == 'C') {
+    bool changed = len > 0;
+    clear();
+    return changed;
+  }
+
+  if (key == '.') {
+    if (point >= 0) {
+      return false;
+    }
+    point = len;
+  } else if (key >= '0' && key <= '9') {
+    uint8_t digits = point < 0 ? len : len - point - 1;
+    if (digits >= (point < 0 ? KEYPAD_ENTRY_INT_DIGITS : KEYPAD_ENTRY_DECIMALS)) {
+      return false;
+    }
+  } else {
+    return false;
+  }
+
+  buf[len++] = key;
+  buf[len] = '\0';
+  return true;
+}
+
+bool KeypadEntry::toGrams(int32_t &grams) const {
+  int32_t value = 0;
+  uint8_t decimals = 0;
+  for (uint8_t i = 0; i < len; i++) {
+    if (buf[i] == '.') {
+      continue;
+    }
+    value = value * 10 + (buf[i] - '0');
+    if (point >= 0 && i > point) {
+      decimals++;
+    }
+  }
+
+  // Scale kg to grams for the decimals that weren't typed
+  for (; decimals < KEYPAD_ENTRY_DECIMALS; decimals++) {
+    value *= 10;
+  }
+
+  grams = value;
+  return value > 0;
+}
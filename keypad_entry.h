@@ -0,0 +1,42 @@
+/**
+ * Fixed-capacity numeric entry for the on-screen keypad.
+ *
+ * Digits and a single decimal point are collected into a char buffer that
+ * lives inside the object, so key presses never touch the heap. The value
+ * is parsed as fixed point: a weight in kg with up to three decimals comes
+ * back as whole grams, no float involved. Keys that would overflow the
+ * buffer or add a fourth decimal are ignored.
+ */
+
+#ifndef KEYPAD_ENTRY_H
+#define KEYPAD_ENTRY_H
+
+#include <stdint.h>
+
+#define KEYPAD_ENTRY_INT_DIGITS 6   // up to 999999 kg
+#define KEYPAD_ENTRY_DECIMALS   3   // down to 1 g
+#define KEYPAD_ENTRY_MAX_CHARS  (KEYPAD_ENTRY_INT_DIGITS + 1 + KEYPAD_ENTRY_DECIMALS)
+
+class KeypadEntry {
+public:
+  KeypadEntry();
+
+  // Apply a keypad key ('0'-'9', '.', 'C' to clear). Returns true if the
+  // text changed and needs redrawing.
+  bool press(char key);
+
+  void clear();
+
+  const char *text() const { return buf; }
+  bool empty() const { return len == 0; }
+
+  // The entered kg as grams. Returns false if nothing (or zero) was entered.
+  bool toGrams(int32_t &grams) const;
+
+private:
+  char buf[KEYPAD_ENTRY_MAX_CHARS + 1];
+  uint8_t len;
+  int8_t point;  // index of the '.', -1 if none
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "load_detector.h"
+
+LoadDetector::LoadDetector(const LoadDetectorConfig &config) : cfg(config) {
+  reset();
+  hasCommitted = false;
+}
+
+void LoadDetector::reset() {
+  current = LOAD_IDLE;
+  bestPlateau = 0;
+  peak = 0;
+  startedAt = 0;
+  restartRun(0);
+}
+
+void LoadDetector::restartRun(int32_t grams) {
+  anchor = grams;
+  runSum = grams;
+  runLength = 1;
+}
+
+int32_t LoadDetector::plateauWeight() const {
+  if (runLength < cfg.stableSamples) {
+    return 0;
+  }
+  return runSum / runLength;
+}
+
+bool LoadDetector::update(int32_t grams, unsigned long now) {
+  if (current == LOAD_IDLE) {
+    if (grams <= cfg.startThreshold) {
+      return false;
+    }
+    current = LOAD_RISING;
+    startedAt = now;
+    peak = grams;
+    bestPlateau = 0;
+    restartRun(grams);
+    return false;
+  }
+
+  if (grams > peak) {
+    peak = grams;
+  }
+
+  // Back to empty: commit if the load ever settled, otherwise it was a bump
+  if (grams < cfg.endThreshold) {
+    bool commit = bestPlateau > 0 || current == LOAD_PLATEAU;
+    if (current == LOAD_PLATEAU && plateauWeight() > bestPlateau) {
+      bestPlateau = plateauWeight();
+    }
+    if (commit) {
+      committed.payload = bestPlateau;
+      committed.peak = peak;
+      committed.startedAt = startedAt;
+      committed.endedAt = now;
+      hasCommitted = true;
+    }
+    current = LOAD_IDLE;
+    return commit;
+  }
+
+  int32_t deviation = grams - anchor;
+  if (deviation >= -cfg.stableBand && deviation <= cfg.stableBand) {
+    // Still inside the band; saturate rather than wrap on very long plateaus
+    if (runLength < 0xFFFF) {
+      runSum += grams;
+      runLength++;
+    }
+    if (current != LOAD_PLATEAU && runLength >= cfg.stableSamples) {
+      current = LOAD_PLATEAU;
+    }
+    return false;
+  }
+
+  // Left the band: close the plateau and follow the direction of travel
+  if (current == LOAD_PLATEAU) {
+    int32_t plateau = plateauWeight();
+    if (plateau > bestPlateau) {
+      bestPlateau = plateau;
+    }
+  }
+  current = deviation > 0 ? LOAD_RISING : LOAD_FALLING;
+  restartRun(grams);
+  return false;
+}
+
+bool LoadDetector::takeCommitted(LoadResult &result) {
+  if (!hasCommitted) {
+    return false;
+  }
+  result = committed;
+  hasCommitted = false;
+  return true;
+}
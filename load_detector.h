@@ -0,0 +1,84 @@
+/**
+ * Load event state machine running on the filtered weight stream.
+ *
+ *   IDLE --above start--> RISING <--> PLATEAU <--> FALLING
+ *     ^                                                |
+ *     +-------- below end (from any state): commit ----+
+ *
+ * The weight counts as stable once `stableSamples` consecutive samples stay
+ * within ±stableBand of the first one. The payload of a load is the mean of
+ * the highest stable plateau seen, so the reading taken while unloading no
+ * longer ends up in the totals, and a load that never settled (a bump, or
+ * someone climbing on the bed) is discarded instead of counted.
+ *
+ * The start and end thresholds form a hysteresis band around zero. Every
+ * update() is O(1) and nothing is buffered, so it runs at the full ADC rate.
+ */
+
+#ifndef LOAD_DETECTOR_H
+#define LOAD_DETECTOR_H
+
+#include <stdint.h>
+
+enum LoadState {
+  LOAD_IDLE,
+  LOAD_RISING,
+  LOAD_PLATEAU,
+  LOAD_FALLING
+};
+
+struct LoadDetectorConfig {
+  int32_t startThreshold;   // grams; leave IDLE above this
+  int32_t endThreshold;     // grams; commit below this (< startThreshold)
+  int32_t stableBand;       // grams either side of the plateau
+  uint16_t stableSamples;   // consecutive samples within the band
+};
+
+struct LoadResult {
+  int32_t payload;          // grams, mean of the highest plateau
+  int32_t peak;             // grams, highest sample of the event
+  unsigned long startedAt;  // ms
+  unsigned long endedAt;    // ms
+};
+
+class LoadDetector {
+public:
+  explicit LoadDetector(const LoadDetectorConfig &config);
+
+  void configure(const LoadDetectorConfig &config) { cfg = config; }
+
+  // Forget any event in progress (e.g. after a tare)
+  void reset();
+
+  // Feed one filtered sample. Returns true when it commits a load.
+  bool update(int32_t grams, unsigned long now);
+
+  // Fetch (and clear) the most recently committed load
+  bool takeCommitted(LoadResult &result);
+
+  LoadState state() const { return current; }
+  bool active() const { return current != LOAD_IDLE; }
+
+  // Mean of the current stable run, or 0 if the weight is not stable
+  int32_t plateauWeight() const;
+
+private:
+  void restartRun(int32_t grams);
+
+  LoadDetectorConfig cfg;
+  LoadState current;
+
+  // Current run of samples within the stable band
+  int32_t anchor;
+  int64_t runSum;
+  uint16_t runLength;
+
+  int32_t bestPlateau;
+  int32_t peak;
+  unsigned long startedAt;
+
+  LoadResult committed;
+  bool hasCommitted;
+};
+
+#endif
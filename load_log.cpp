@@ -0,0 +1,27 @@
+#include "load_log.h"
+
+LoadLog::LoadLog(int baseAddress, uint8_t slots) : ring(baseAddress, slots) {
+}
+
+bool LoadLog::append(const LoadEvent &event) {
+  uint8_t payload[EEPROM_RING_PAYLOAD];
+  ringWriteU32(payload, event.timestamp);
+  ringWriteU32(payload + 4, (uint32_t) event.payload);
+  payload[8] = event.duration & 0xFF;
+  payload[9] = event.duration >> 8;
+  payload[10] = LOAD_LOG_PAYLOAD;
+  return ring.append(payload);
+}
+
+bool LoadLog::read(uint32_t sequence, LoadEvent &event) const {
+  uint8_t payload[EEPROM_RING_PAYLOAD];
+  if (!ring.read(sequence, payload)) {
+    return false;
+  }
+  event.sequence = sequence;
+  event.timestamp = ringReadU32(payload);
+  event.payload = (int32_t) ringReadU32(payload + 4);
+  event.duration = payload[8] | (uint16_t) payload[9] << 8;
+  event.format = payload[10];
+  return true;
+}
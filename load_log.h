@@ -0,0 +1,62 @@
+/**
+ * Per-load event log kept in an EEPROMRing (see eeprom_ring.h).
+ *
+ * Each completed load is appended as one compact 16-byte record; once the
+ * region is full the oldest loads are overwritten. Records are read back
+ * one at a time straight from EEPROM, so walking the log needs no RAM
+ * beyond a single LoadEvent:
+ *
+ *   LoadEvent e;
+ *   for (uint32_t s = log.oldestSequence(); s <= log.newestSequence(); s++) {
+ *     if (log.read(s, e)) { ... }
+ *   }
+ *
+ * Payload layout (little endian):
+ *   0  uint32 timestamp (millis() when the load was committed)
+ *   4  int32  weight (grams), see format
+ *   8  uint16 duration (seconds on the scale)
+ *   10 uint8  format: LOAD_LOG_PAYLOAD, the payload booked in the totals;
+ *             LOAD_LOG_PEAK (records written before it), the peak
+ *
+ * The peak of a load only goes to the telemetry stream and the SD log.
+ */
+
+#ifndef LOAD_LOG_H
+#define LOAD_LOG_H
+
+#include "eeprom_ring.h"
+
+// LoadEvent::format
+#define LOAD_LOG_PEAK    0
+#define LOAD_LOG_PAYLOAD 1
+
+struct LoadEvent {
+  uint32_t sequence;
+  uint32_t timestamp;
+  int32_t payload;   // grams; the peak in LOAD_LOG_PEAK records
+  uint16_t duration;
+  uint8_t format;
+};
+
+class LoadLog {
+public:
+  LoadLog(int baseAddress, uint8_t slots);
+
+  void begin() { ring.begin(); }
+
+  // Stage an event for writing. Returns false while the previous event is
+  // still being written.
+  bool append(const LoadEvent &event);
+
+  void service() { ring.service(); }
+  bool busy() const { return ring.busy(); }
+
+  uint32_t oldestSequence() const { return ring.oldestSequence(); }
+  uint32_t newestSequence() const { return ring.newestSequence(); }
+  bool read(uint32_t sequence, LoadEvent &event) const;
+
+private:
+  EEPROMRing ring;
+};
+
+#endif
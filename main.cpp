@@ -4,6 +4,15 @@
  * This code reads load cell data using the HX711 amplifier and displays it on a touchscreen interface.
  * It keeps track of the total number of loads and total weight, storing data in EEPROM.
  * Includes buttons for Tare, Store, Reset, and Calibrate.
+ *
+ * HX711 conversions are collected on the DOUT falling edge by an interrupt
+ * driven sampler (hx711_sampler.h), so the ADC runs at its full rate while
+ * loop() services the display and touchscreen. loop() itself only runs a
+ * cooperative scheduler (scheduler.h) that drives acquisition, load
+ * detection, touch, display and EEPROM persistence at their own rates.
+ * A fault monitor (fault_monitor.h) checks every conversion as it is read,
+ * drives the overload output and kicks the hardware watchdog. A parked
+ * truck sends the board to sleep (power_manager.h) until the load changes.
  * 
  * Hardware Components:
  * - Arduino Uno
@@ -12,28 +21,199 @@
  * - Adafruit 2.8" TFT Touch Shield for Arduino
  * 
  * Libraries Required:
- * - HX711 Library by Bogdan Necula
  * - Adafruit GFX Library
  * - Adafruit TouchScreen Library
  * - MCUFRIEND_kbv Library
  * - EEPROM Library (built-in)
+ * - SPI Library (built-in, for the optional SD card history)
  */
 
-#include "HX711.h"
 #include <Adafruit_GFX.h>
 #include <MCUFRIEND_kbv.h>
 #include <TouchScreen.h>
 #include <EEPROM.h>
-
-// HX711 pins
+#include "hx711_sampler.h"
+#include "scheduler.h"
+#include "display_field.h"
+#include "segment_field.h"
+#include "weight_filter.h"
+#include "eeprom_layout.h"
+#include "totals_journal.h"
+#include "load_log.h"
+#include "load_detector.h"
+#include "telemetry.h"
+#include "weight_units.h"
+#include "profiler.h"
+#include "keypad_entry.h"
+#include "widget.h"
+#include "touch_input.h"
+#include "frame_averager.h"
+#include "config_store.h"
+#include "calibration_curve.h"
+#include "flow_rate.h"
+#include "zero_tracker.h"
+#include "shift_stats.h"
+#include "bulk_log.h"
+#include "command_parser.h"
+#include "tracked_display.h"
+#include "page.h"
+#include "fault_monitor.h"
+#include "power_manager.h"
+
+// 16-bit RGB565 colours
+#define BLACK   0x0000
+#define BLUE    0x001F
+#define RED     0xF800
+#define GREEN   0x07E0
+#define WHITE   0xFFFF
+
+// Function prototypes, so the sketch also builds as plain C++ (PlatformIO,
+// and the host simulation in sim/)
+void acquireTask();
+void telemetryTask();
+void loadStateTask();
+void touchTask();
+void displayTask();
+void persistTask();
+void paintTask();
+void profileTask();
+void temperatureTask();
+void statsTask();
+void bulkLogTask();
+void commandTask();
+void faultTask();
+void onFrame(const HX711Frame &frame);
+void powerTask();
+bool canSleep();
+void sleepOnce();
+void wakeUp();
+void setBacklight(uint8_t level);
+void handleCommand();
+void streamReply();
+void resetTotals();
+void saveStats();
+void sendStats(uint8_t kind, const LoadStats &stats);
+void updateStats(bool opaque);
+bool readPress(int &x, int &y);
+void processSample(const HX711Frame &frame);
+void startBootTare();
+void checkSavedTare(const HX711Frame &frame);
+void startTare();
+void finishTare();
+void finishCalibrationPoint();
+void showCalibrationPoints(const char *note);
+void applyCalibration();
+bool overloaded();
+int32_t overloadLimit();
+void updateAlarm();
+void showNotice(const char *text);
+void showProgress(int16_t x, int16_t y, const char *label);
+void updateConversion();
+void updateDisplay();
+void updateDiagnostics(bool opaque);
+bool calibrating();
+void mainEnter();
+void mainUpdate();
+void mainTouch(int16_t x, int16_t y, uint8_t action);
+void calibrateEnter();
+void calibrateUpdate();
+void calibratePoll();
+void calibrateTouch(int16_t x, int16_t y, uint8_t action);
+void calibratedEnter();
+void calibratedPoll();
+void statsEnter();
+void statsUpdate();
+void diagnosticsEnter();
+void diagnosticsUpdate();
+void settingsEnter();
+void settingsTouch(int16_t x, int16_t y, uint8_t action);
+void drawSettingsField(uint8_t field);
+void closeTouch(int16_t x, int16_t y, uint8_t action);
+int32_t EEPROMReadLong(int address);
+int64_t EEPROMReadLongLong(int address);
+bool EEPROMReadFloat(int address, uint8_t shift, int64_t &value);
+bool readLegacyTotals(uint16_t &count, int64_t &grams);
+
+// HX711 pins. Each load cell has its own HX711 on its own DOUT pin and
+// all of them share SCK; list one DOUT pin per cell, e.g. { 3, 4, 5, 6 }
+// for four axle cells. Only the first needs to be an interrupt pin.
 #define HX711_DT  3
 #define HX711_SCK 2
-
-// Initialize HX711
-HX711 scale(HX711_DT, HX711_SCK);
-
-// Calibration factor for the scale (You need to calibrate this for your setup)
-float calibration_factor = -7050; // Initial calibration factor
+const uint8_t hx711_dout_pins[] = { HX711_DT };
+#define CHANNEL_COUNT (sizeof(hx711_dout_pins) / sizeof(hx711_dout_pins[0]))
+
+// Streams conversions from the HX711s in the background (DT is INT1 on the Uno)
+HX711Sampler sampler;
+
+// Tare and the calibration reading average frames in the background, fed
+// from acquireTask, so the UI keeps running (and can cancel) meanwhile
+#define TARE_SAMPLES        16
+#define CALIBRATION_SAMPLES 32
+enum AveragingJob {
+  JOB_NONE,
+  JOB_TARE,
+  JOB_CALIBRATE
+};
+FrameAverager averager;
+AveragingJob averaging_job = JOB_NONE;
+
+// No weight is shown or booked until the first tare has completed
+bool scale_zeroed = false;
+
+// At boot the saved tare offsets are kept if the first frame weighs less
+// than this with them (grams, the load start threshold), i.e. the deck is
+// still empty; otherwise the scale is tared afresh
+#define TARE_RESTORE_BAND 2000
+bool tare_check_pending = false;
+
+// Known weight (grams) the calibration reading is taken against
+int32_t calibration_known_weight = 0;
+
+// Progress percentage currently on screen, PROGRESS_NONE if none
+#define PROGRESS_NONE 0xFF
+uint8_t progress_shown = PROGRESS_NONE;
+
+// Filter pipeline between the gross weight (grams, the sum of all
+// channels) and current_weight: a short median rejects spikes, then a
+// moving average smooths out vibration.
+#define SPIKE_FILTER_TYPE    FILTER_MEDIAN
+#define SPIKE_FILTER_PARAM   5
+#define SMOOTH_FILTER_TYPE   FILTER_MOVING_AVERAGE
+#define SMOOTH_FILTER_PARAM  8
+WeightFilter spikeFilter;
+WeightFilter smoothFilter;
+
+// Binary telemetry stream (every sample and load) on the USB serial port
+#define TELEMETRY_BAUD 115200
+Telemetry telemetry;
+
+// Requests from the host on the same port (command_parser.h): a few
+// received bytes are parsed per run, and a request is only taken once its
+// longest reply fits in the telemetry queue
+#define COMMAND_BYTES_PER_RUN 16
+CommandParser commandParser;
+
+// Reply stream in progress: the request it answers (0 if none), the next
+// load or history block, how many are left and, within a history block,
+// the offset of the next chunk
+uint8_t stream_type = 0;
+uint32_t stream_next = 0;
+uint16_t stream_left = 0;
+uint16_t stream_offset = 0;
+
+// Calibration factor of each channel (You need to calibrate this for your
+// setup; raw counts per kg in fixed point, see weight_units.h), the tare
+// offsets and the display ID, saved together in one EEPROM block
+ConfigStore configStore(EEPROM_CONFIG_ADDR);
+DeviceConfig config;
+
+// Multi-point calibration of the gross weight; with fewer than two points
+// the calibration factors alone convert counts to grams
+CalibrationCurve curve(EEPROM_CAL_CURVE_A_ADDR, EEPROM_CAL_CURVE_B_ADDR);
+
+// Grams per raw count in Q24, derived from the calibration factor so that the
+// per-sample conversion is a multiply instead of a division
+int64_t grams_per_count[CHANNEL_COUNT];
 
 // Touchscreen pins, XP, XM, YP, YM
 #define YP A3  // must be an analog pin, use "An" notation!
@@ -48,432 +228,1743 @@ float calibration_factor = -7050; // Initial calibration factor
 
 // Touchscreen setup
 TouchScreen ts = TouchScreen(XP, YP, XM, YM, 300);
-MCUFRIEND_kbv tft;
 
-// EEPROM Addresses
-#define EEPROM_LOAD_COUNT_ADDR 0        // Addresses 0 and 1
-#define EEPROM_TOTAL_WEIGHT_ADDR 2      // Addresses 2 to 5
-#define EEPROM_CAL_FACTOR_ADDR 6        // Addresses 6 to 9
+// The display tracks what has been drawn, so a page change only clears
+// that (clearDrawn()) rather than the whole screen
+TrackedDisplay tft(BLACK);
 
-// Variables for load tracking
-float last_weight = 0;
-float current_weight = 0;
-float total_weight = 0;
-int load_count = 0;
+// Debounced press/release events from the touchscreen
+TouchInput touchInput(ts, XM, YP);
+
+// Load count and total weight are saved to a wear-leveled journal
+TotalsJournal journal(EEPROM_JOURNAL_ADDR, EEPROM_JOURNAL_SLOTS);
 
-// State variables
-bool load_detected = false;
+// Every completed load is also logged individually
+LoadLog loadLog(EEPROM_LOAD_LOG_ADDR, EEPROM_LOAD_LOG_SLOTS);
 
-// Button coordinates and dimensions
+// Variables for load tracking, all in grams. The total is 64-bit so it
+// keeps gram resolution however many tonnes accumulate.
+int32_t current_weight = 0;
+int64_t total_weight = 0;
+int load_count = 0;
+
+// Per-channel (axle) weights summed between display updates, so the axle
+// readout shows the average instead of a single noisy sample
+#define AXLE_AVERAGE_MAX 64
+int32_t axle_sum[CHANNEL_COUNT];
+uint8_t axle_samples = 0;
+
+// Readings closer to zero than this are treated as an empty scale (grams)
+#define ZERO_BAND 500
+
+// Zero tracking follows slow drift of the empty reading between tares.
+// Band, stable band, largest step and range are grams; a window of 80
+// samples is ~1 s, so zero moves by at most 20 g/s.
+const ZeroTrackerConfig zero_tracker_config = {
+  1000,   // band
+  200,    // stable band
+  80,     // window samples
+  20,     // largest step
+  20000,  // range
+  0       // temperature drift model, grams per degree C
+};
+ZeroTracker zeroTracker(zero_tracker_config);
+
+// Optional TMP36 on A5 (the pin the TFT shield leaves free) for the zero
+// tracker's temperature drift model; set the grams per degree above too
+#ifndef TEMP_SENSOR_ENABLED
+#define TEMP_SENSOR_ENABLED 0
+#endif
+#define TEMP_SENSOR_PIN A5
+
+// Buzzer or relay output (high = alarm), driven from the sampler on the
+// first conversion over the overload limit and on sensor faults. It takes
+// A5 as well, so move one of them if the TMP36 is fitted.
+#ifndef ALARM_PIN
+#define ALARM_PIN A5
+#endif
+static_assert(!TEMP_SENSOR_ENABLED || ALARM_PIN != TEMP_SENSOR_PIN, "ALARM_PIN and TEMP_SENSOR_PIN are both A5");
+FaultMonitor fault(ALARM_PIN);
+
+// Idle mode: with no weight change of 50 kg, touch or serial request for
+// IDLE_AFTER ms the HX711s are powered down and the board sleeps, waking
+// every POWER_SLEEP_MS to look at the weight. Serial requests sent while
+// it sleeps are lost, the next one after a check wakes it.
+#ifndef IDLE_ENABLED
+#define IDLE_ENABLED 1
+#endif
+#ifndef IDLE_AFTER
+#define IDLE_AFTER 120000UL
+#endif
+const PowerConfig power_config = {
+  IDLE_AFTER,
+  500,    // check timeout (ms), past the 400 ms settling at 10 SPS
+  50000   // wake band (grams)
+};
+PowerManager power(power_config);
+
+// Backlight PWM, dimmed while idle. The shields drive the backlight from
+// 3.3 V unless it is rewired to a pin; D11 is free (Timer2, so no clash
+// with the profiler's Timer1) when the SD history is not built in.
+#ifndef BACKLIGHT_ENABLED
+#define BACKLIGHT_ENABLED 0
+#endif
+#define BACKLIGHT_PIN  11
+#define BACKLIGHT_FULL 255
+#define BACKLIGHT_DIM  16
+static_assert(!BACKLIGHT_ENABLED || !BULK_LOG_ENABLED, "BACKLIGHT_PIN is the SD card's MOSI");
+
+// Load event detection: start/end thresholds (hysteresis), stable band
+// (all grams) and how many consecutive samples make a plateau (~0.5 s)
+const LoadDetectorConfig detector_config = {
+  2000,   // start
+  1000,   // end
+  200,    // stable band
+  40      // stable samples
+};
+LoadDetector detector(detector_config);
+
+// Loading rate over the last few seconds of the filtered weight. With a
+// target payload set in the config, the time left to reach it is shown
+// too, and an alarm once the weight is more than the overload margin
+// over it. A fresh EEPROM starts with these defaults (0 = no target).
+#define DEFAULT_TARGET_PAYLOAD   0L   // grams
+#define DEFAULT_OVERLOAD_PERCENT 5
+FlowRateEstimator flowRate;
+
+// Completed load waiting to be written to the load log
+LoadEvent pending_event;
+bool event_pending = false;
+
+// Set when totals need to be written to EEPROM by the persistence task
+bool persist_pending = false;
+
+// Seconds clock for the shift statistics. There is no RTC, so after a
+// power loss it carries on from the last saved statistics (the time the
+// power was off is lost); a fresh EEPROM starts it at the first shift.
+uint32_t clock_seconds = 0;
+unsigned long clock_ticked_at = 0;
+
+// Load statistics per shift and per day: three 8 h shifts, the first of
+// the day starting at 06:00. They are saved on Store, when a shift ends
+// and otherwise at most every STATS_SAVE_INTERVAL after a load, to spare
+// the EEPROM.
+#define SHIFT_HOURS         8
+#define DAY_START_HOUR      6
+#define STATS_SAVE_INTERVAL 600000UL  // ms
+ShiftStats shiftStats(EEPROM_STATS_ADDR, SHIFT_HOURS * 3600UL, DAY_START_HOUR * 3600UL);
+bool stats_save_pending = false;
+unsigned long stats_saved_at = 0;
+
+// Optional sample and load history on the shield's microSD card (build
+// with BULK_LOG_ENABLED=1), written raw as a ring over the first
+// BULK_LOG_BLOCKS blocks: anything else on the card is overwritten
+#if BULK_LOG_ENABLED
+#define SD_CS_PIN            10
+#define BULK_LOG_FIRST_BLOCK 0
+#define BULK_LOG_BLOCKS      1000000UL  // 512 MB, fits a 1 GB card
+SdCard sdCard(SD_CS_PIN);
+BulkLog bulkLog(sdCard, BULK_LOG_FIRST_BLOCK, BULK_LOG_BLOCKS);
+#endif
+
+// The current weight in large seven-segment digits (kg, one decimal), so
+// it can be read from the cab; only segments that change are redrawn
+#define WEIGHT_X 20
+#define WEIGHT_Y 12
+SegmentField weightDigits(WEIGHT_X, WEIGHT_Y, 7, 36, 64, 8, GREEN, BLACK);
+
+// Value fields on the main screen; each repaints only the characters
+// that changed since it was last drawn
+DisplayField loadCountField(200, 90, 10, 2, GREEN, BLACK);
+DisplayField totalWeightField(200, 115, 10, 2, GREEN, BLACK);
+
+// Loading rate, time to the target payload and the overload alarm, on the
+// line above the buttons
+DisplayField rateField(20, 182, 12, 2, GREEN, BLACK);
+DisplayField etaField(200, 182, 9, 2, GREEN, BLACK);
+DisplayField alarmField(340, 182, 8, 2, RED, BLACK);
+
+// With more than one load cell, each axle's weight is shown on a small
+// line of its own below the totals
+static_assert(HX711_MAX_CHANNELS <= 4, "one axle field per channel");
+DisplayField axleFields[4] = {
+  DisplayField(0, 135, 12, 1, GREEN, BLACK),
+  DisplayField(80, 135, 12, 1, GREEN, BLACK),
+  DisplayField(160, 135, 12, 1, GREEN, BLACK),
+  DisplayField(240, 135, 12, 1, GREEN, BLACK),
+};
+
+// Button dimensions
 #define BUTTON_W 100
 #define BUTTON_H 40
+#define BUTTON_Y 200
+
+// Main screen buttons: x, y, w, h, colour, label offset, label, action
+enum ButtonAction {
+  ACTION_TARE = 1,
+  ACTION_STORE,
+  ACTION_RESET,
+  ACTION_CALIBRATE
+};
+
+const Widget main_buttons[] PROGMEM = {
+  { 10,  BUTTON_Y, BUTTON_W, BUTTON_H, BLUE, 10, "Tare",  ACTION_TARE },
+  { 120, BUTTON_Y, BUTTON_W, BUTTON_H, BLUE, 5,  "Store", ACTION_STORE },
+  { 230, BUTTON_Y, BUTTON_W, BUTTON_H, RED,  5,  "Reset", ACTION_RESET },
+  { 340, BUTTON_Y, BUTTON_W, BUTTON_H, BLUE, 5,  "Calib", ACTION_CALIBRATE },
+};
+#define MAIN_BUTTON_COUNT (sizeof(main_buttons) / sizeof(main_buttons[0]))
+
+// Calibration keypad: a 4x3 grid of keys (E for Enter, which measures a
+// point) with Clear and Done below it. Keys return their character.
+#define KEYPAD_X       240
+#define KEYPAD_Y       40
+#define KEYPAD_KEY_W   60
+#define KEYPAD_KEY_H   40
+#define KEYPAD_SPACING 10
+#define KEYPAD_ROWS    4
+#define KEYPAD_COLS    3
+
+const WidgetGrid keypad_grid PROGMEM = {
+  KEYPAD_X, KEYPAD_Y, KEYPAD_KEY_W, KEYPAD_KEY_H, KEYPAD_SPACING,
+  KEYPAD_ROWS, KEYPAD_COLS, 20, BLUE,
+  { '1', '2', '3',
+    '4', '5', '6',
+    '7', '8', '9',
+    '.', '0', 'E' }
+};
+
+#define KEYPAD_W        (KEYPAD_COLS * KEYPAD_KEY_W + (KEYPAD_COLS - 1) * KEYPAD_SPACING)
+#define KEYPAD_BOTTOM_Y (KEYPAD_Y + KEYPAD_ROWS * (KEYPAD_KEY_H + KEYPAD_SPACING))
+#define KEYPAD_BOTTOM_W ((KEYPAD_W - KEYPAD_SPACING) / 2)
+
+const Widget keypad_buttons[] PROGMEM = {
+  { KEYPAD_X, KEYPAD_BOTTOM_Y, KEYPAD_BOTTOM_W, KEYPAD_KEY_H,
+    RED, KEYPAD_BOTTOM_W / 2 - 6, "C", 'C' },
+  { KEYPAD_X + KEYPAD_BOTTOM_W + KEYPAD_SPACING, KEYPAD_BOTTOM_Y, KEYPAD_BOTTOM_W, KEYPAD_KEY_H,
+    BLUE, KEYPAD_BOTTOM_W / 2 - 24, "Done", 'D' },
+};
+#define KEYPAD_BUTTON_COUNT (sizeof(keypad_buttons) / sizeof(keypad_buttons[0]))
+
+// Touching the left of the main screen above the notification line (the
+// weight readout and the labels) opens the profiler page
+#define DIAGNOSTICS_TOUCH_W 190
+#define DIAGNOSTICS_TOUCH_H 130
+
+// Touching the total values opens the shift statistics page, and any
+// touch closes it again
+#define STATS_TOUCH_X 200
+#define STATS_TOUCH_Y 85
+#define STATS_TOUCH_H 50
+
+// Touching the unit right of the weight opens the settings page
+#define SETTINGS_TOUCH_X 360
+#define SETTINGS_TOUCH_H 85
 
-// Tare button
-#define TARE_BUTTON_X 10
-#define TARE_BUTTON_Y 200
+// Calibration variables
+KeypadEntry enteredWeight;
+
+// Calibration confirmation is shown for this long before returning (ms)
+#define CALIBRATION_CONFIRM_TIME 3000
+unsigned long calibration_confirmed_at = 0;
+
+// Settings page: the target payload (kg) and overload margin (%) being
+// entered, and which of the two the keypad edits
+#define SETTING_TARGET 0
+#define SETTING_MARGIN 1
+KeypadEntry settingEntries[2];
+uint8_t setting_field = SETTING_TARGET;
+
+// Profiled sections; the index is the section id in PROFILE_SCOPE() and
+// in the telemetry profile packets
+enum ProfileId {
+  PROFILE_LOOP,
+  PROFILE_SAMPLE,
+  PROFILE_TOUCH,
+  PROFILE_DISPLAY,
+  PROFILE_EEPROM,
+  PROFILE_TELEMETRY
+};
+
+#if PROFILER_ENABLED
+// Section table: name, budget (us)
+ProfileSection profile_sections[] = {
+  { "loop",      5000 },
+  { "sample",    500 },
+  { "touch",     1000 },
+  { "display",   20000 },
+  { "eeprom",    500 },
+  { "telemetry", 500 },
+};
+Profiler profiler(profile_sections, sizeof(profile_sections) / sizeof(profile_sections[0]));
+
+// Every interval the statistics go out as telemetry, one section per
+// profile task run so the packets don't crowd out the sample stream
+#define PROFILER_DUMP_INTERVAL 5000
+unsigned long profile_dump_at = 0;
+uint8_t profile_dump_next = 0;
+
+#endif
+
+// Pages of the UI (page.h): static text, buttons and handlers. Text is
+// white at size 2 unless noted.
+const char text_total_loads[] PROGMEM = "Total Loads:";
+const char text_total_weight[] PROGMEM = "Total Weight:";
+const PageText main_texts[] PROGMEM = {
+  { 20, 90,  2, WHITE, text_total_loads },
+  { 20, 115, 2, WHITE, text_total_weight },
+};
+const Page main_page PROGMEM = {
+  main_texts, 2, main_buttons, MAIN_BUTTON_COUNT, 0,
+  mainEnter, mainUpdate, 0, mainTouch
+};
+
+const char text_fill_truck[] PROGMEM = "Fill the truck";
+const char text_known_weight[] PROGMEM = "with known weight";
+const char text_enter_weight[] PROGMEM = "Enter weight in kg:";
+const PageText calibrate_texts[] PROGMEM = {
+  { 20, 40,  2, WHITE, text_fill_truck },
+  { 20, 70,  2, WHITE, text_known_weight },
+  { 20, 110, 2, WHITE, text_enter_weight },
+};
+const Page calibrate_page PROGMEM = {
+  calibrate_texts, 3, keypad_buttons, KEYPAD_BUTTON_COUNT, &keypad_grid,
+  calibrateEnter, calibrateUpdate, calibratePoll, calibrateTouch
+};
+
+// Shown for CALIBRATION_CONFIRM_TIME after Done, then back to main
+const char text_calibrated[] PROGMEM = "Weight calibrated";
+const PageText calibrated_texts[] PROGMEM = {
+  { 20, 80, 2, WHITE, text_calibrated },
+};
+const Page calibrated_page PROGMEM = {
+  calibrated_texts, 1, 0, 0, 0,
+  calibratedEnter, 0, calibratedPoll, 0
+};
+
+const char text_stats_title[] PROGMEM = "Statistics (t)  touch to close";
+const char text_stats_header[] PROGMEM = "          shift     day last sh lastday";
+const PageText stats_texts[] PROGMEM = {
+  { 6, 10, 2, WHITE, text_stats_title },
+  { 6, 40, 2, WHITE, text_stats_header },
+};
+const Page stats_page PROGMEM = {
+  stats_texts, 2, 0, 0, 0,
+  statsEnter, statsUpdate, 0, closeTouch
+};
+
+#if PROFILER_ENABLED
+const char text_profiler_title[] PROGMEM = "Profiler (us)  touch to close";
+const char text_profiler_header[] PROGMEM = "section     avg   max  over";
+const PageText diagnostics_texts[] PROGMEM = {
+  { 10, 10, 2, WHITE, text_profiler_title },
+  { 10, 40, 2, WHITE, text_profiler_header },
+};
+const Page diagnostics_page PROGMEM = {
+  diagnostics_texts, 2, 0, 0, 0,
+  diagnosticsEnter, diagnosticsUpdate, 0, closeTouch
+};
+#endif
+
+// Target payload and overload margin on the keypad: E moves to the other
+// field, Done saves both (an empty target means none)
+const char text_settings[] PROGMEM = "Settings";
+const char text_target[] PROGMEM = "Target load (kg):";
+const char text_margin[] PROGMEM = "Overload (%):";
+const char text_next_field[] PROGMEM = "E: next field";
+const PageText settings_texts[] PROGMEM = {
+  { 20, 10,  2, WHITE, text_settings },
+  { 20, 45,  2, WHITE, text_target },
+  { 20, 115, 2, WHITE, text_margin },
+  { 20, 190, 2, WHITE, text_next_field },
+};
+const Page settings_page PROGMEM = {
+  settings_texts, 4, keypad_buttons, KEYPAD_BUTTON_COUNT, &keypad_grid,
+  settingsEnter, 0, 0, settingsTouch
+};
+
+// Settings input fields, below their labels
+#define SETTING_FIELD_Y(f) (70 + 70 * (f))
+#define SETTING_FIELD_X 20
+#define SETTING_FIELD_W 200
+#define SETTING_FIELD_H 30
+
+PageManager pages(tft, WHITE);
+
+// The main screen is painted after setup() by paintTask, one band per
+// pass, so acquisition runs in between and the first weight is taken
+// before the screen is complete
+#define PAINT_BANDS 4
+uint8_t paint_step = 0;  // PAINT_BANDS + 1 once painted
+
+// Task table: name, function, period (ms), deadline (ms).
+// Tasks run in table order, so the sensor path comes first.
+Task tasks[] = {
+  { "acquire",   acquireTask,   0,    5 },
+  { "telemetry", telemetryTask, 0,    5 },
+  { "load",      loadStateTask, 10,   10 },
+  { "touch",     touchTask,     10,   50 },
+  { "paint",     paintTask,     0,    50 },
+  { "display",   displayTask,   250,  100 },
+  { "persist",   persistTask,   5,    20 },
+  { "stats",     statsTask,     100,  100 },
+  { "command",   commandTask,   2,    20 },
+  { "fault",     faultTask,     50,   20 },
+#if IDLE_ENABLED
+  { "power",     powerTask,     5,    20 },
+#endif
+#if BULK_LOG_ENABLED
+  { "bulklog",   bulkLogTask,   2,    20 },
+#endif
+#if PROFILER_ENABLED
+  { "profile",   profileTask,   20,   50 },
+#endif
+#if TEMP_SENSOR_ENABLED
+  { "temp",      temperatureTask, 1000, 100 },
+#endif
+};
+Scheduler scheduler(tasks, sizeof(tasks) / sizeof(tasks[0]));
 
-// Store Values button
-#define STORE_BUTTON_X 120
-#define STORE_BUTTON_Y 200
+void setup() {
+  fault.begin(CHANNEL_COUNT);
+  setBacklight(BACKLIGHT_FULL);
+  telemetry.begin(TELEMETRY_BAUD);
+#if PROFILER_ENABLED
+  profiler.begin();
+#endif
+
+  // Read the settings in one pass. Without a valid config block, take the
+  // calibration factors from where they were kept before it existed: the
+  // integer cells, or the float the first firmware kept for one cell.
+  // The block is saved below along with the display ID.
+  if (!configStore.begin(config)) {
+    memset(&config, 0, sizeof(config));
+    for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+      config.calibrationFactor[c] = EEPROMReadLong(EEPROM_CAL_FACTOR_ADDR + 4 * c);
+    }
+    int64_t factor;
+    if (config.calibrationFactor[0] == -1 && EEPROMReadFloat(EEPROM_FLOAT_CAL_ADDR, CAL_FACTOR_FRAC_BITS, factor) &&
+        factor != 0 && factor > -0x7FFFFFFFL && factor < 0x7FFFFFFFL) {
+      config.calibrationFactor[0] = (int32_t) factor;
+    }
+    config.targetPayload = DEFAULT_TARGET_PAYLOAD;
+    config.overloadPercent = DEFAULT_OVERLOAD_PERCENT;
+  }
+  for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+    if (config.calibrationFactor[c] == -1) {  // Erased
+      config.calibrationFactor[c] = DEFAULT_CAL_FACTOR;
+    }
+  }
+  updateConversion();
+  curve.begin();
+
+  spikeFilter.configure(SPIKE_FILTER_TYPE, SPIKE_FILTER_PARAM);
+  smoothFilter.configure(SMOOTH_FILTER_TYPE, SMOOTH_FILTER_PARAM);
+
+  // Restore the newest saved totals (none yet on a fresh EEPROM). An
+  // empty journal may still have totals from before it, saved once here.
+  uint16_t stored_count;
+  int64_t stored_weight;
+  if (journal.begin(stored_count, stored_weight)) {
+    load_count = stored_count;
+    total_weight = stored_weight;
+  } else if (readLegacyTotals(stored_count, stored_weight)) {
+    load_count = stored_count;
+    total_weight = stored_weight;
+    persist_pending = true;
+  }
+  loadLog.begin();
+  if (shiftStats.begin()) {
+    clock_seconds = shiftStats.clock();
+  } else {
+    clock_seconds = DAY_START_HOUR * 3600UL;
+  }
+  shiftStats.tick(clock_seconds);
 
-// Reset All button
-#define RESET_BUTTON_X 230
-#define RESET_BUTTON_Y 200
+  // The controller ID is probed once and cached. Painting is left to
+  // paintTask, so only the controller's own start-up delays remain here.
+  if (config.displayId == 0 || config.displayId == 0xFFFF) {
+    config.displayId = tft.readID();
+    configStore.save(config);
+  }
+  tft.begin(config.displayId);
+  tft.setRotation(1);
 
-// Calibrate button
-#define CALIBRATE_BUTTON_X 340
-#define CALIBRATE_BUTTON_Y 200
+#if BULK_LOG_ENABLED
+  bulkLog.setClock(clock_seconds);
+  bulkLog.begin();
+#endif
+
+  // Start the interrupt-driven sampler and zero the scale. Done last so
+  // frames don't pile up in the queue while the display initialises.
+  sampler.begin(hx711_dout_pins, CHANNEL_COUNT, HX711_SCK);
+  sampler.setFrameHook(onFrame);
+  sampler.start();
+  startBootTare();
+
+  scheduler.begin();
+  power.begin(millis());
+  fault.startWatchdog();
+}
 
-// Calibration variables
-bool isCalibrating = false;
-String enteredWeight = "";
+void loop() {
+  PROFILE_SCOPE(profiler, PROFILE_LOOP);
+  fault.kick();
+  scheduler.run();
+}
 
-void setup() {
-  Serial.begin(9600);
+// Drain every frame the sampler has collected since the last pass.
+// Frames also feed a tare or calibration reading in progress. They are
+// not weighed while calibrating, before the scale has been zeroed or
+// while a cell is faulty.
+void acquireTask() {
+  sampler.poll();
+  HX711Frame frame;
+  while (sampler.read(frame)) {
+    if (tare_check_pending) {
+      checkSavedTare(frame);
+    }
+    if (averager.add(frame) && averaging_job == JOB_TARE) {
+      finishTare();
+    }
+    if (!calibrating() && scale_zeroed && !fault.cellFault()) {
+      processSample(frame);
+    }
+  }
+}
+
+// Every conversion, straight from the sampler's interrupt
+void onFrame(const HX711Frame &frame) {
+  fault.frame(frame);
+}
 
-  // Read stored calibration factor from EEPROM
-  calibration_factor = EEPROMReadFloat(EEPROM_CAL_FACTOR_ADDR);
-  if (isnan(calibration_factor) || calibration_factor == 0) {
-    calibration_factor = -7050; // Default value
+// An HX711 that stopped converting may have powered down (SCK left high)
+// or been disconnected: restarting the sampler pulls SCK low again
+void faultTask() {
+  if (fault.check(millis())) {
+    sampler.stop();
+    sampler.start();
   }
-  scale.set_scale(calibration_factor);
-  scale.tare();  // Reset the scale to 0
+}
 
-  // Read stored values from EEPROM
-  load_count = EEPROMReadInt(EEPROM_LOAD_COUNT_ADDR);
-  total_weight = EEPROMReadFloat(EEPROM_TOTAL_WEIGHT_ADDR);
+#if IDLE_ENABLED
+// Goes idle once nothing has happened for IDLE_AFTER, and while idle
+// sleeps again after each check that found nothing
+void powerTask() {
+  unsigned long now = millis();
+  if (power.idle()) {
+    if (power.checkDone(now)) {
+      sleepOnce();
+    }
+  } else if (power.idleDue(now) && canSleep()) {
+    setBacklight(BACKLIGHT_DIM);
+    showNotice("Idle");
+    sleepOnce();
+  }
+}
 
-  uint16_t ID = tft.readID();
-  tft.begin(ID);
+// Nothing in progress that sleeping would lose or hold up
+bool canSleep() {
+  return scale_zeroed && averaging_job == JOB_NONE && !detector.active() &&
+         pages.showing(&main_page) && !persist_pending && !event_pending &&
+         stream_type == 0 && Serial.available() == 0 &&
+#if BULK_LOG_ENABLED
+         (bulkLog.state() == BULK_IDLE || bulkLog.state() == BULK_OFF) &&
+#endif
+         (fault.faults() & ~FAULT_WATCHDOG_RESET) == 0;
+}
 
-  tft.setRotation(1);
-  tft.fillScreen(BLACK);
+// One sleep period with the HX711s powered down and the UART drained
+void sleepOnce() {
+  while (!telemetry.idle()) {
+    telemetry.service();
+  }
+  Serial.flush();
+  sampler.powerDown();
+  unsigned long asleep = millis();
+  power.sleep();
+  scheduler.pause(millis() - asleep);
+  fault.startWatchdog();
+  sampler.powerUp();
+  fault.expectFrames(millis());
+}
+#endif
 
-  // Draw initial UI
-  drawUI();
+// Back from idle mode, on a weight change, a touch or a request
+void wakeUp() {
+  setBacklight(BACKLIGHT_FULL);
+  if (pages.showing(&main_page)) {
+    showNotice("");
+  }
 }
 
-void loop() {
-  if (isCalibrating) {
-    handleCalibration();
+void setBacklight(uint8_t level) {
+#if BACKLIGHT_ENABLED
+  analogWrite(BACKLIGHT_PIN, level);
+#endif
+}
+
+// Book-keeping for loads the detector has committed
+void loadStateTask() {
+  LoadResult load;
+  if (!detector.takeCommitted(load)) {
+    return;
+  }
+
+  total_weight += load.payload;
+  load_count++;
+
+  pending_event.timestamp = load.endedAt;
+  pending_event.payload = load.payload;
+  pending_event.duration = (load.endedAt - load.startedAt) / 1000;
+  event_pending = true;
+
+  persist_pending = true;
+
+  telemetry.sendLoad(load.endedAt, load.payload, load.peak, pending_event.duration);
+#if BULK_LOG_ENABLED
+  bulkLog.logLoad(load.payload, load.peak, pending_event.duration);
+#endif
+
+  shiftStats.add(load.payload, clock_seconds);
+  stats_save_pending = true;
+  sendStats(STATS_SHIFT, shiftStats.shift());
+  sendStats(STATS_DAY, shiftStats.day());
+}
+
+// Keeps the seconds clock, closes the shift (and day) statistics when it
+// crosses into the next one and saves them when due
+void statsTask() {
+  unsigned long now = millis();
+  while (now - clock_ticked_at >= 1000) {
+    clock_ticked_at += 1000;
+    clock_seconds++;
+  }
+#if BULK_LOG_ENABLED
+  bulkLog.setClock(clock_seconds);
+#endif
+
+  if (shiftStats.tick(clock_seconds)) {
+    sendStats(STATS_PREVIOUS_SHIFT, shiftStats.previousShift());
+    sendStats(STATS_PREVIOUS_DAY, shiftStats.previousDay());
+    saveStats();
+  } else if (stats_save_pending && now - stats_saved_at >= STATS_SAVE_INTERVAL) {
+    saveStats();
+  }
+}
+
+void saveStats() {
+  shiftStats.save();
+  stats_save_pending = false;
+  stats_saved_at = millis();
+}
+
+void sendStats(uint8_t kind, const LoadStats &stats) {
+  telemetry.sendStats(kind, stats.count, stats.sum, stats.min, stats.max, stats.mean(), stats.deviation());
+}
+
+void telemetryTask() {
+  PROFILE_SCOPE(profiler, PROFILE_TELEMETRY);
+  telemetry.service();
+}
+
+// Clears the screen one band per run, then draws the main screen. After
+// that it has nothing left to do. Bands are whole display tiles, so the
+// display knows the screen is blank afterwards.
+void paintTask() {
+  if (paint_step > PAINT_BANDS) {
+    return;
+  }
+  if (paint_step < PAINT_BANDS) {
+    int16_t h = (tft.height() + PAINT_BANDS - 1) / PAINT_BANDS;
+    h = (h + TRACK_TILE - 1) & ~(TRACK_TILE - 1);
+    tft.fillRect(0, paint_step * h, tft.width(), h, BLACK);
   } else {
-    // Read the scale
-    current_weight = scale.get_units();
+    pages.show(&main_page);
+    if (fault.faults() & FAULT_WATCHDOG_RESET) {
+      showNotice("Watchdog reset");
+    }
+  }
+  paint_step++;
+}
+
+void displayTask() {
+  if (paint_step <= PAINT_BANDS) {
+    return;  // Main screen not painted yet
+  }
+  pages.update();
+}
+
+#if BULK_LOG_ENABLED
+// Packs staged records into the block buffer and moves a block write
+// along by one chunk
+void bulkLogTask() {
+  bulkLog.service();
+}
+#endif
+
+// Answers one host request at a time: a stream in progress sends its
+// next reply, otherwise received bytes are parsed until a request is
+// complete
+void commandTask() {
+  if (!telemetry.canSend(TELEMETRY_MAX_PAYLOAD)) {
+    return;  // Replies would be dropped, leave the bytes in the UART
+  }
+  if (stream_type != 0) {
+    streamReply();
+    return;
+  }
+  if (Serial.available() > 0 && power.activity(millis())) {
+    wakeUp();
+  }
+  for (uint8_t n = 0; n < COMMAND_BYTES_PER_RUN && Serial.available() > 0; n++) {
+    if (commandParser.feed(Serial.read())) {
+      handleCommand();
+      return;
+    }
+  }
+}
+
+static uint8_t *putU16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+  return p + 2;
+}
+
+static uint8_t *putU32(uint8_t *p, uint32_t v) {
+  for (uint8_t i = 0; i < 4; i++) {
+    p[i] = v >> (8 * i);
+  }
+  return p + 4;
+}
+
+static uint32_t getU32(const uint8_t *p) {
+  return p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
 
-    // Simple filter to remove noise around zero
-    if (abs(current_weight) < 0.5) {
-      current_weight = 0;
+// Carry out the request in commandParser and queue its reply, or start
+// the stream answering it. Payload layouts are in command_parser.h.
+void handleCommand() {
+  uint8_t type = commandParser.type();
+  const uint8_t *p = commandParser.payload();
+  uint8_t len = commandParser.length();
+  uint8_t reply[TELEMETRY_MAX_PAYLOAD - 1];
+  uint8_t *end = reply;
+  uint8_t status = COMMAND_OK;
+
+  switch (type) {
+    case CMD_STATUS: {
+      if (len != 0) {
+        status = COMMAND_BAD_REQUEST;
+        break;
+      }
+      uint8_t flags = (scale_zeroed ? COMMAND_FLAG_ZEROED : 0) |
+                      (calibrating() ? COMMAND_FLAG_CALIBRATING : 0) |
+                      (averaging_job == JOB_TARE ? COMMAND_FLAG_TARING : 0) |
+                      (detector.active() ? COMMAND_FLAG_LOADING : 0) |
+                      (overloaded() || fault.alarmed() ? COMMAND_FLAG_OVERLOAD : 0) |
+                      (fault.faults() ? COMMAND_FLAG_FAULT : 0);
+      end = putU32(end, millis());
+      end = putU32(end, (uint32_t) current_weight);
+      *end++ = flags;
+      end = putU32(end, clock_seconds);
+      end = putU16(end, sampler.droppedSamples());
+      end = putU16(end, telemetry.droppedPackets());
+#if BULK_LOG_ENABLED
+      *end++ = bulkLog.state();
+      end = putU32(end, bulkLog.nextSequence());
+#else
+      *end++ = BULK_OFF;
+      end = putU32(end, 0);
+#endif
+      *end++ = fault.faults();
+      *end++ = fault.faultChannels();
+      break;
     }
 
-    // Detect load weight when scale goes back to zero
-    if (current_weight > 0) {
-      load_detected = true;
-      last_weight = current_weight;
-    } else if (current_weight == 0 && load_detected) {
-      // Load has been unloaded
-      total_weight += last_weight;
-      load_count++;
-      last_weight = 0;
-      load_detected = false;
+    case CMD_TOTALS:
+      if (len != 0) {
+        status = COMMAND_BAD_REQUEST;
+        break;
+      }
+      end = putU16(end, load_count);
+      end = putU32(end, (uint32_t) total_weight);
+      end = putU32(end, (uint32_t) ((uint64_t) total_weight >> 32));
+      break;
+
+    case CMD_STATS: {
+      if (len != 1 || p[0] > STATS_PREVIOUS_DAY) {
+        status = COMMAND_BAD_REQUEST;
+        break;
+      }
+      const LoadStats *columns[4] = {
+        &shiftStats.shift(), &shiftStats.day(), &shiftStats.previousShift(), &shiftStats.previousDay()
+      };
+      const LoadStats &s = *columns[p[0]];
+      Telemetry::packStats(end, p[0], s.count, s.sum, s.min, s.max, s.mean(), s.deviation());
+      end += TELEMETRY_STATS_SIZE;
+      break;
     }
 
-    // Update display
-    updateDisplay();
-
-    // Handle touch input
-    TSPoint p = ts.getPoint();
-    pinMode(XM, OUTPUT);
-    pinMode(YP, OUTPUT);
-
-    if (p.z > ts.pressureThreshhold) {
-      // Map touchscreen coordinates
-      int x = map(p.x, TS_MINX, TS_MAXX, 0, tft.width());
-      int y = map(p.y, TS_MINY, TS_MAXY, 0, tft.height());
-
-      // Check if Tare button was pressed
-      if (x > TARE_BUTTON_X && x < (TARE_BUTTON_X + BUTTON_W) && y > TARE_BUTTON_Y && y < (TARE_BUTTON_Y + BUTTON_H)) {
-        scale.tare();
-        current_weight = 0;
-        last_weight = 0;
-        load_detected = false;
-        tft.fillRect(0, 0, tft.width(), 160, BLACK);  // Clear the upper part of the screen
+    case CMD_SET_CALIBRATION:
+      // The same factor for every cell, as a one-point calibration
+      if (len != 4 || getU32(p) == 0) {
+        status = COMMAND_BAD_REQUEST;
+      } else if (calibrating()) {
+        status = COMMAND_BUSY;
+      } else {
+        for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+          config.calibrationFactor[c] = (int32_t) getU32(p);
+        }
+        updateConversion();
+        configStore.save(config);
+        curve.clear();
+        curve.save();
+      }
+      break;
+
+    case CMD_SET_TARGET:
+      if (len != 5 || (int32_t) getU32(p) < 0) {
+        status = COMMAND_BAD_REQUEST;
+      } else {
+        config.targetPayload = (int32_t) getU32(p);
+        config.overloadPercent = p[4];
+        configStore.save(config);
+        updateAlarm();
       }
+      break;
+
+    case CMD_SET_CLOCK:
+      // statsTask closes the shift and day if this moves into another one
+      if (len != 4) {
+        status = COMMAND_BAD_REQUEST;
+      } else {
+        clock_seconds = getU32(p);
+        clock_ticked_at = millis();
+      }
+      break;
+
+    case CMD_TARE:
+      if (len != 0) {
+        status = COMMAND_BAD_REQUEST;
+      } else if (calibrating() || averaging_job != JOB_NONE) {
+        status = COMMAND_BUSY;
+      } else {
+        startTare();
+      }
+      break;
 
-      // Check if Store Values button was pressed
-      else if (x > STORE_BUTTON_X && x < (STORE_BUTTON_X + BUTTON_W) && y > STORE_BUTTON_Y && y < (STORE_BUTTON_Y + BUTTON_H)) {
-        // Store current total_weight and load_count to EEPROM
-        EEPROMWriteInt(EEPROM_LOAD_COUNT_ADDR, load_count);
-        EEPROMWriteFloat(EEPROM_TOTAL_WEIGHT_ADDR, total_weight);
-        tft.fillRect(0, 160, tft.width(), 20, BLACK);  // Clear notification area
-        tft.setCursor(20, 160);
-        tft.setTextColor(GREEN);
-        tft.setTextSize(2);
-        tft.print("Values Stored");
+    case CMD_RESET:
+      if (len != 0) {
+        status = COMMAND_BAD_REQUEST;
+      } else {
+        resetTotals();
       }
+      break;
 
-      // Check if Reset All button was pressed
-      else if (x > RESET_BUTTON_X && x < (RESET_BUTTON_X + BUTTON_W) && y > RESET_BUTTON_Y && y < (RESET_BUTTON_Y + BUTTON_H)) {
-        // Reset all values and clear EEPROM
-        total_weight = 0;
-        load_count = 0;
-        last_weight = 0;
-        current_weight = 0;
-        load_detected = false;
-
-        // Clear EEPROM values
-        EEPROMWriteInt(EEPROM_LOAD_COUNT_ADDR, load_count);
-        EEPROMWriteFloat(EEPROM_TOTAL_WEIGHT_ADDR, total_weight);
-
-        // Clear display
-        tft.fillRect(0, 0, tft.width(), 160, BLACK);  // Clear the upper part of the screen
-
-        tft.fillRect(0, 160, tft.width(), 20, BLACK);  // Clear notification area
-        tft.setCursor(20, 160);
-        tft.setTextColor(GREEN);
-        tft.setTextSize(2);
-        tft.print("All Values Reset");
+    case CMD_READ_LOADS:
+      if (len != 5) {
+        status = COMMAND_BAD_REQUEST;
+        break;
       }
+      stream_type = type;
+      stream_next = getU32(p);
+      if (stream_next < loadLog.oldestSequence()) {
+        stream_next = loadLog.oldestSequence();
+      }
+      stream_left = p[4];
+      return;
 
-      // Check if Calibrate button was pressed
-      else if (x > CALIBRATE_BUTTON_X && x < (CALIBRATE_BUTTON_X + BUTTON_W) && y > CALIBRATE_BUTTON_Y && y < (CALIBRATE_BUTTON_Y + BUTTON_H)) {
-        isCalibrating = true;
-        startCalibration();
+    case CMD_READ_HISTORY:
+      if (len != 6) {
+        status = COMMAND_BAD_REQUEST;
+        break;
       }
+#if BULK_LOG_ENABLED
+      if (bulkLog.state() != BULK_OFF) {
+        stream_type = type;
+        stream_next = getU32(p);
+        if (stream_next < bulkLog.oldestSequence()) {
+          stream_next = bulkLog.oldestSequence();
+        }
+        stream_left = p[4] | (uint16_t) p[5] << 8;
+        stream_offset = 0;
+        return;
+      }
+#endif
+      status = COMMAND_UNAVAILABLE;
+      break;
+
+    default:
+      status = COMMAND_BAD_REQUEST;
+      break;
+  }
+  telemetry.sendReply(type | COMMAND_REPLY, status, reply, end - reply);
+}
+
+// Next reply of the stream in progress: one load, or one chunk of a
+// history block, per run. A history download waits while the log itself
+// is using the card.
+void streamReply() {
+  uint8_t reply[TELEMETRY_MAX_PAYLOAD - 1];
+  uint8_t *end = reply;
+
+  if (stream_type == CMD_READ_LOADS) {
+    LoadEvent e;
+    while (stream_left > 0 && stream_next <= loadLog.newestSequence()) {
+      stream_left--;
+      if (loadLog.read(stream_next++, e)) {
+        end = putU32(end, e.sequence);
+        end = putU32(end, e.timestamp);
+        end = putU32(end, (uint32_t) e.payload);
+        end = putU16(end, e.duration);
+        *end++ = e.format;
+        telemetry.sendReply(stream_type | COMMAND_REPLY, COMMAND_OK, reply, end - reply);
+        return;
+      }
+    }
+  }
+#if BULK_LOG_ENABLED
+  if (stream_type == CMD_READ_HISTORY) {
+    BulkLogState state = bulkLog.state();
+    if (state != BULK_IDLE && state != BULK_OFF) {
+      return;
+    }
+    if (state == BULK_IDLE && stream_left > 0 && stream_next < bulkLog.nextSequence()) {
+      end = putU32(end, stream_next);
+      end = putU16(end, stream_offset);
+      bool read = bulkLog.readBlock(stream_next, stream_offset, end, COMMAND_CHUNK);
+      if (read) {
+        telemetry.sendReply(stream_type | COMMAND_REPLY, COMMAND_OK, reply, end + COMMAND_CHUNK - reply);
+      }
+      // On to the next block once this one is sent, or if it can't be read
+      stream_offset += COMMAND_CHUNK;
+      if (!read || stream_offset >= SD_BLOCK_SIZE) {
+        stream_next++;
+        stream_left--;
+        stream_offset = 0;
+      }
+      return;
     }
+  }
+#endif
+  telemetry.sendReply(stream_type | COMMAND_REPLY, COMMAND_END, reply, 0);
+  stream_type = 0;
+}
+
+#if TEMP_SENSOR_ENABLED
+// TMP36: 10 mV per degree C with 500 mV at 0 C, so with a 5 V reference
+// millivolts - 500 is tenths of a degree
+void temperatureTask() {
+  int32_t mV = (int32_t) analogRead(TEMP_SENSOR_PIN) * 5000 / 1024;
+  zeroTracker.setTemperature(mV - 500);
+}
+#endif
+
+#if PROFILER_ENABLED
+// Sends one section's window statistics per run once a dump is due, then
+// starts that section's next window
+void profileTask() {
+  if (profile_dump_next == 0 && (long) (millis() - profile_dump_at) < 0) {
+    return;
+  }
+
+  ProfileReport r;
+  profiler.report(profile_dump_next, r);
+  if (!telemetry.sendProfile(profile_dump_next, r.count, r.min, r.max, r.avg, r.overruns)) {
+    return;  // Queue full, try again next run
+  }
+  profiler.restart(profile_dump_next);
 
-    delay(200);
+  if (++profile_dump_next >= profiler.sectionCount()) {
+    profile_dump_next = 0;
+    profile_dump_at = millis() + PROFILER_DUMP_INTERVAL;
   }
 }
+#endif
+
+// Read the touchscreen if it is due. Returns true with the screen
+// position of a new press; releases and long presses aren't used yet.
+bool readPress(int &x, int &y) {
+  unsigned long now = millis();
+  if (!touchInput.due(now)) {
+    return false;
+  }
 
-void drawUI() {
-  // Draw Tare Button
-  tft.fillRect(TARE_BUTTON_X, TARE_BUTTON_Y, BUTTON_W, BUTTON_H, BLUE);
-  tft.drawRect(TARE_BUTTON_X, TARE_BUTTON_Y, BUTTON_W, BUTTON_H, WHITE);
-  tft.setTextColor(WHITE);
-  tft.setTextSize(2);
-  tft.setCursor(TARE_BUTTON_X + 10, TARE_BUTTON_Y + 10);
-  tft.print("Tare");
+  PROFILE_SCOPE(profiler, PROFILE_TOUCH);
+  TouchEvent event;
+  if (!touchInput.update(now, event) || event.type != TOUCH_PRESS) {
+    return false;
+  }
 
-  // Draw Store Values Button
-  tft.fillRect(STORE_BUTTON_X, STORE_BUTTON_Y, BUTTON_W, BUTTON_H, BLUE);
-  tft.drawRect(STORE_BUTTON_X, STORE_BUTTON_Y, BUTTON_W, BUTTON_H, WHITE);
-  tft.setTextColor(WHITE);
-  tft.setTextSize(2);
-  tft.setCursor(STORE_BUTTON_X + 5, STORE_BUTTON_Y + 10);
-  tft.print("Store");
+  // Map touchscreen coordinates
+  x = map(event.x, TS_MINX, TS_MAXX, 0, tft.width());
+  y = map(event.y, TS_MINY, TS_MAXY, 0, tft.height());
+  return true;
+}
 
-  // Draw Reset All Button
-  tft.fillRect(RESET_BUTTON_X, RESET_BUTTON_Y, BUTTON_W, BUTTON_H, RED);
-  tft.drawRect(RESET_BUTTON_X, RESET_BUTTON_Y, BUTTON_W, BUTTON_H, WHITE);
-  tft.setTextColor(WHITE);
+void touchTask() {
+  if (paint_step <= PAINT_BANDS) {
+    return;  // No buttons on screen yet
+  }
+  pages.poll();
+
+  // Each press is reported once however long it is held
+  int x, y;
+  if (readPress(x, y)) {
+    // A press that wakes the board from idle does nothing else
+    if (power.activity(millis())) {
+      wakeUp();
+      return;
+    }
+    pages.touch(x, y);
+  }
+}
+
+// The statistics and profiler pages close on any touch
+void closeTouch(int16_t x, int16_t y, uint8_t action) {
+  pages.show(&main_page);
+}
+
+// Weighing stops while a calibration is being measured and confirmed
+bool calibrating() {
+  return pages.showing(&calibrate_page) || pages.showing(&calibrated_page);
+}
+
+// Reset all values and clear EEPROM
+void resetTotals() {
+  total_weight = 0;
+  load_count = 0;
+  current_weight = 0;
+  detector.reset();
+
+  // Clear EEPROM values
+  persist_pending = true;
+}
+
+// Saves the totals after every load and on Store/Reset, appends each
+// completed load to the load log and writes out changed settings.
+// Records are written one byte per run, so this never waits on an EEPROM
+// write; totals that change while a record is in flight go out in the
+// next record.
+void persistTask() {
+  if (persist_pending && journal.append(load_count, total_weight)) {
+    persist_pending = false;
+  }
+  if (event_pending && loadLog.append(pending_event)) {
+    event_pending = false;
+  }
+
+  // One EEPROM byte per run: totals first, settings last
+  PROFILE_SCOPE(profiler, PROFILE_EEPROM);
+  if (journal.busy()) {
+    journal.service();
+  } else if (loadLog.busy()) {
+    loadLog.service();
+  } else if (configStore.busy()) {
+    configStore.service();
+  } else if (curve.busy()) {
+    curve.service();
+  } else {
+    shiftStats.service();
+  }
+}
+
+void processSample(const HX711Frame &frame) {
+  PROFILE_SCOPE(profiler, PROFILE_SAMPLE);
+
+  // Remove each channel's tare offset and scale to grams
+  int32_t gross = 0;
+  int32_t net = 0;
+  int32_t raw = 0;
+  if (axle_samples >= AXLE_AVERAGE_MAX) {
+    memset(axle_sum, 0, sizeof(axle_sum));
+    axle_samples = 0;
+  }
+  for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+    int32_t grams = countsToGrams(frame.raw[c] - config.tareOffset[c], grams_per_count[c]);
+    axle_sum[c] += grams;
+    gross += grams;
+    net += frame.raw[c] - config.tareOffset[c];
+    raw += frame.raw[c];
+  }
+  axle_samples++;
+  if (curve.active()) {
+    gross = curve.toGrams(net);
+  }
+  unsigned long now = millis();
+  if (power.sample(gross, now)) {
+    wakeUp();
+  }
+
+  current_weight = smoothFilter.update(spikeFilter.update(gross)) - zeroTracker.correction();
+  zeroTracker.update(current_weight, !detector.active());
+
+  // Simple filter to remove noise around zero
+  if (abs(current_weight) < ZERO_BAND) {
+    current_weight = 0;
+  }
+
+  detector.update(current_weight, now);
+  flowRate.update(current_weight, now);
+  telemetry.sendSample(raw, current_weight);
+#if BULK_LOG_ENABLED
+  bulkLog.logSample(raw);
+#endif
+}
+
+// Recompute the per-count gains after a calibration factor changes
+void updateConversion() {
+  for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+    if (config.calibrationFactor[c] == 0) {
+      config.calibrationFactor[c] = DEFAULT_CAL_FACTOR;
+    }
+    grams_per_count[c] = gramsPerCount(config.calibrationFactor[c]);
+  }
+  updateAlarm();
+}
+
+// Boot keeps the saved tare offsets if they still weigh the scale empty,
+// which checkSavedTare() decides on the first frame; without saved
+// offsets (or with a different number of channels) it tares afresh
+void startBootTare() {
+  if (config.tareChannels == CHANNEL_COUNT) {
+    tare_check_pending = true;
+  } else {
+    startTare();
+  }
+}
+
+void checkSavedTare(const HX711Frame &frame) {
+  tare_check_pending = false;
+  int32_t gross = 0;
+  int32_t net = 0;
+  for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+    gross += countsToGrams(frame.raw[c] - config.tareOffset[c], grams_per_count[c]);
+    net += frame.raw[c] - config.tareOffset[c];
+  }
+  if (curve.active()) {
+    gross = curve.toGrams(net);
+  }
+  if (abs(gross) < TARE_RESTORE_BAND) {
+    scale_zeroed = true;
+    updateAlarm();
+  } else {
+    startTare();
+  }
+}
+
+// Start zeroing every channel on its current reading; finishTare() runs
+// once TARE_SAMPLES frames have been averaged
+void startTare() {
+  averager.start(CHANNEL_COUNT, TARE_SAMPLES);
+  averaging_job = JOB_TARE;
+}
+
+void finishTare() {
+  HX711Frame average;
+  averager.take(average);
+  averaging_job = JOB_NONE;
+
+  // The offsets are saved for the next boot, unless they moved less than
+  // a reading that would show as zero anyway
+  bool moved = config.tareChannels != CHANNEL_COUNT;
+  for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+    if (abs(countsToGrams(average.raw[c] - config.tareOffset[c], grams_per_count[c])) >= ZERO_BAND) {
+      moved = true;
+    }
+    config.tareOffset[c] = average.raw[c];
+  }
+  if (moved) {
+    config.tareChannels = CHANNEL_COUNT;
+    configStore.save(config);
+  }
+  scale_zeroed = true;
+  updateAlarm();
+
+  // The filters and detector hold weights from before the tare
+  spikeFilter.reset();
+  smoothFilter.reset();
+  memset(axle_sum, 0, sizeof(axle_sum));
+  axle_samples = 0;
+  current_weight = 0;
+  detector.reset();
+  flowRate.reset();
+  zeroTracker.reset();
+}
+
+// Grams over which the load is an overload, 0 without a target
+int32_t overloadLimit() {
+  if (config.targetPayload <= 0) {
+    return 0;
+  }
+  int64_t limit = config.targetPayload + (int64_t) config.targetPayload * config.overloadPercent / 100;
+  return limit > 0x7FFFFFFFL ? 0x7FFFFFFFL : (int32_t) limit;
+}
+
+bool overloaded() {
+  int32_t limit = overloadLimit();
+  return limit > 0 && current_weight > limit;
+}
+
+// Hand the fault monitor the tare, gains and limit it checks the raw
+// conversions against; the alarm stays off until the scale is zeroed
+void updateAlarm() {
+  fault.setAlarm(config.tareOffset, grams_per_count, scale_zeroed ? overloadLimit() : 0);
+}
+
+// Replace the notification line with text ("" just clears it)
+void showNotice(const char *text) {
+  tft.fillRect(0, 160, tft.width(), 20, BLACK);  // Clear notification area
+  tft.setCursor(20, 160);
+  tft.setTextColor(GREEN);
   tft.setTextSize(2);
-  tft.setCursor(RESET_BUTTON_X + 5, RESET_BUTTON_Y + 10);
-  tft.print("Reset");
+  tft.print(text);
+  progress_shown = PROGRESS_NONE;
+}
 
-  // Draw Calibrate Button
-  tft.fillRect(CALIBRATE_BUTTON_X, CALIBRATE_BUTTON_Y, BUTTON_W, BUTTON_H, BLUE);
-  tft.drawRect(CALIBRATE_BUTTON_X, CALIBRATE_BUTTON_Y, BUTTON_W, BUTTON_H, WHITE);
-  tft.setTextColor(WHITE);
+// "label NN%" for the averaging in progress, redrawn only when the
+// percentage changes. Opaque text, so no clear is needed.
+void showProgress(int16_t x, int16_t y, const char *label) {
+  uint8_t percent = averager.progress();
+  if (percent == progress_shown) {
+    return;
+  }
+  char text[DISPLAY_FIELD_MAX_CHARS + 1];
+  uint8_t len = formatDecimal(text, percent, 0);
+  strcpy(text + len, "%  ");
+  tft.setCursor(x, y);
+  tft.setTextColor(GREEN, BLACK);
   tft.setTextSize(2);
-  tft.setCursor(CALIBRATE_BUTTON_X + 5, CALIBRATE_BUTTON_Y + 10);
-  tft.print("Calib");
+  tft.print(label);
+  tft.print(' ');
+  tft.print(text);
+  progress_shown = percent;
+}
 
-  // Labels
+// Paint the values on the main screen; it is only ever drawn onto a
+// cleared display
+void mainEnter() {
   tft.setTextColor(WHITE);
-  tft.setTextSize(2);
-  tft.setCursor(20, 20);
-  tft.print("Current Weight:");
-  tft.setCursor(20, 60);
-  tft.print("Total Loads:");
-  tft.setCursor(20, 100);
-  tft.print("Total Weight:");
-
-  // Display initial values
+  tft.setTextSize(3);
+  tft.setCursor(WEIGHT_X + weightDigits.width() + 10, WEIGHT_Y + 64 - 24);
+  tft.print("kg");
+
+  weightDigits.cleared();
+  loadCountField.cleared();
+  totalWeightField.cleared();
+  rateField.cleared();
+  etaField.cleared();
+  alarmField.cleared();
+  for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+    axleFields[c].cleared();
+  }
   updateDisplay();
 }
 
+void mainUpdate() {
+  updateDisplay();
+
+  // Tare progress on the notification line, cleared once it is done
+  if (averaging_job == JOB_TARE) {
+    showProgress(20, 160, "Taring");
+  } else if (progress_shown != PROGRESS_NONE) {
+    showNotice("");
+  }
+}
+
+void mainTouch(int16_t x, int16_t y, uint8_t action) {
+  // Touching the totals opens the statistics page, the labels the
+  // profiler page and the unit the settings page
+  if (x >= STATS_TOUCH_X && y >= STATS_TOUCH_Y && y < STATS_TOUCH_Y + STATS_TOUCH_H) {
+    pages.show(&stats_page);
+    return;
+  }
+#if PROFILER_ENABLED
+  if (x < DIAGNOSTICS_TOUCH_W && y < DIAGNOSTICS_TOUCH_H) {
+    pages.show(&diagnostics_page);
+    return;
+  }
+#endif
+  if (x >= SETTINGS_TOUCH_X && y < SETTINGS_TOUCH_H) {
+    pages.show(&settings_page);
+    return;
+  }
+
+  switch (action) {
+    case ACTION_TARE:
+      // A second press cancels a tare in progress (but not the first
+      // one after power-up, which nothing can be weighed without)
+      if (averaging_job == JOB_NONE) {
+        startTare();
+      } else if (averaging_job == JOB_TARE && scale_zeroed) {
+        averager.cancel();
+        averaging_job = JOB_NONE;
+        showNotice("Tare cancelled");
+      }
+      break;
+
+    case ACTION_STORE:
+      // Store current total_weight, load_count and the statistics to EEPROM
+      persist_pending = true;
+      saveStats();
+      showNotice("Values Stored");
+      break;
+
+    case ACTION_RESET:
+      resetTotals();
+      showNotice("All Values Reset");
+      break;
+
+    case ACTION_CALIBRATE:
+      pages.show(&calibrate_page);
+      break;
+  }
+}
+
 void updateDisplay() {
+  PROFILE_SCOPE(profiler, PROFILE_DISPLAY);
+  char text[DISPLAY_FIELD_MAX_CHARS + 1];
+  uint8_t len;
+
   // Current Weight
-  tft.fillRect(200, 20, 120, 20, BLACK);
-  tft.setCursor(200, 20);
-  tft.setTextColor(GREEN);
-  tft.setTextSize(2);
-  tft.print(current_weight, 1);
-  tft.print(" kg");
+  formatDecimal(text, roundedDiv(current_weight, 100), 1);
+  weightDigits.show(tft, text);
 
   // Total Loads
-  tft.fillRect(200, 60, 120, 20, BLACK);
-  tft.setCursor(200, 60);
-  tft.setTextColor(GREEN);
-  tft.setTextSize(2);
-  tft.print(load_count);
+  formatDecimal(text, load_count, 0);
+  loadCountField.show(tft, text);
 
   // Total Weight
-  tft.fillRect(200, 100, 120, 20, BLACK);
-  tft.setCursor(200, 100);
-  tft.setTextColor(GREEN);
-  tft.setTextSize(2);
-  tft.print(total_weight / 1000, 1);  // Convert kg to tons
-  tft.print(" tons");
-}
+  len = formatDecimal(text, roundedDiv(total_weight, 100000), 1);  // Convert grams to tons
+  strcpy(text + len, " tons");
+  totalWeightField.show(tft, text);
+
+  // Loading rate, as "12.3 kg/s", while a load is coming on
+  text[0] = '\0';
+  if (detector.active() && flowRate.ready()) {
+    len = formatDecimal(text, roundedDiv(flowRate.rate(), 100), 1);
+    strcpy(text + len, " kg/s");
+  }
+  rateField.show(tft, text);
 
-void startCalibration() {
-  // Clear screen and display instructions
-  tft.fillScreen(BLACK);
-  tft.setTextColor(WHITE);
-  tft.setTextSize(2);
-  tft.setCursor(20, 40);
-  tft.print("Fill the truck");
-  tft.setCursor(20, 70);
-  tft.print("with known weight");
-  tft.setCursor(20, 110);
-  tft.print("Enter weight in kg:");
+  // Time to the target payload at that rate, as "ETA 2:05"
+  long eta = -1;
+  if (config.targetPayload > 0 && detector.active()) {
+    eta = flowRate.timeTo(config.targetPayload, current_weight);
+  }
+  text[0] = '\0';
+  if (eta >= 0 && eta < 6000) {
+    strcpy(text, "ETA ");
+    len = 4 + formatDecimal(text + 4, eta / 60, 0);
+    text[len++] = ':';
+    text[len++] = '0' + eta % 60 / 10;
+    text[len++] = '0' + eta % 10;
+    text[len] = '\0';
+  }
+  etaField.show(tft, text);
+
+  // Sensor faults before the overload, which can't be judged then
+  const char *alarm = "";
+  if (fault.faults() & FAULT_ADC_TIMEOUT) {
+    alarm = "NO ADC";
+  } else if (fault.faults() & FAULT_SATURATED) {
+    alarm = "CELL SAT";
+  } else if (fault.faults() & FAULT_STUCK) {
+    alarm = "CELL ERR";
+  } else if (overloaded() || fault.alarmed()) {
+    alarm = "OVERLOAD";
+  }
+  alarmField.show(tft, alarm);
+
+  // Axle weights, as "1: 12345 kg"
+  if (CHANNEL_COUNT > 1 && axle_samples > 0) {
+    for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+      text[0] = '1' + c;
+      text[1] = ':';
+      text[2] = ' ';
+      len = 3 + formatDecimal(text + 3, roundedDiv(axle_sum[c] / axle_samples, 1000), 0);
+      strcpy(text + len, " kg");
+      axleFields[c].show(tft, text);
+    }
+    memset(axle_sum, 0, sizeof(axle_sum));
+    axle_samples = 0;
+  }
+}
 
+// The calibration page: instructions and keypad come from the layout
+void calibrateEnter() {
   // Draw a rectangle for the input field
   tft.drawRect(20, 140, 200, 30, WHITE);
   tft.setCursor(25, 145);
   tft.setTextColor(GREEN);
-  tft.print(enteredWeight);
-
-  // Draw keypad
-  drawKeypad();
-}
-
-void handleCalibration() {
-  TSPoint p = ts.getPoint();
-  pinMode(XM, OUTPUT);
-  pinMode(YP, OUTPUT);
-
-  if (p.z > ts.pressureThreshhold) {
-    // Map touchscreen coordinates
-    int x = map(p.x, TS_MINX, TS_MAXX, 0, tft.width());
-    int y = map(p.y, TS_MINY, TS_MAXY, 0, tft.height());
-
-    // Handle keypad input
-    char key = getKeypadInput(x, y);
-    if (key != 0) {
-      if (key >= '0' && key <= '9') {
-        enteredWeight += key;
-      } else if (key == '.') {
-        if (!enteredWeight.contains(".")) {
-          enteredWeight += key;
-        }
-      } else if (key == 'C') {
-        // Clear input
-        enteredWeight = "";
-      } else if (key == 'E') {
-        // Enter key pressed
-        if (enteredWeight.length() > 0) {
-          float knownWeight = enteredWeight.toFloat();
-
-          // Read raw average value from the scale
-          float rawValue = scale.read_average(10);
-
-          // Calculate new calibration factor
-          calibration_factor = rawValue / knownWeight;
-
-          // Update the scale with the new calibration factor
-          scale.set_scale(calibration_factor);
-
-          // Save calibration factor to EEPROM
-          EEPROMWriteFloat(EEPROM_CAL_FACTOR_ADDR, calibration_factor);
-
-          // Display confirmation
-          tft.fillScreen(BLACK);
-          tft.setTextColor(WHITE);
-          tft.setTextSize(2);
-          tft.setCursor(20, 80);
-          tft.print("Known weight is");
-          tft.setCursor(20, 110);
-          tft.print(knownWeight, 1);
-          tft.print(" kg");
-          tft.setCursor(20, 140);
-          tft.print("Weight calibrated");
-
-          delay(3000); // Wait for 3 seconds
-
-          // Redraw the UI
-          tft.fillScreen(BLACK);
-          drawUI();
-          isCalibrating = false;
-          enteredWeight = "";
-        }
-      }
+  tft.print(enteredWeight.text());
+
+  // Every calibration measures its points afresh
+  curve.clear();
+  showCalibrationPoints("");
+}
 
+void calibrateUpdate() {
+  if (averaging_job == JOB_CALIBRATE) {
+    showProgress(25, 145, "Measuring");
+  }
+}
+
+void calibratePoll() {
+  if (averaging_job == JOB_CALIBRATE && averager.done()) {
+    finishCalibrationPoint();
+  }
+}
+
+void calibrateTouch(int16_t x, int16_t y, uint8_t action) {
+  char key = action;
+  if (averaging_job == JOB_CALIBRATE) {
+    // Only Clear does anything while measuring: it cancels the reading
+    if (key != 'C') {
+      return;
+    }
+    averager.cancel();
+    averaging_job = JOB_NONE;
+  }
+
+  if (key != 0) {
+    int32_t knownWeight;  // grams
+    if (key == 'D') {
+      applyCalibration();
+    } else if (key == 'E') {
+      // Enter key pressed: take the reading in the background
+      if (averaging_job == JOB_NONE && enteredWeight.toGrams(knownWeight)) {
+        calibration_known_weight = knownWeight;
+        averager.start(CHANNEL_COUNT, CALIBRATION_SAMPLES);
+        averaging_job = JOB_CALIBRATE;
+        tft.fillRect(21, 141, 198, 28, BLACK);
+        progress_shown = PROGRESS_NONE;
+      }
+    } else if (enteredWeight.press(key) || key == 'C') {
       // Update the input field
       tft.fillRect(21, 141, 198, 28, BLACK);
       tft.setCursor(25, 145);
       tft.setTextColor(GREEN);
-      tft.print(enteredWeight);
+      tft.print(enteredWeight.text());
     }
-    delay(200);
   }
 }
 
-void drawKeypad() {
-  // Define keypad buttons
-  const char keys[4][3] = {
-    {'1', '2', '3'},
-    {'4', '5', '6'},
-    {'7', '8', '9'},
-    {'.', '0', 'E'} // E for Enter
-  };
+// A calibration point has been measured: add it to the curve
+void finishCalibrationPoint() {
+  // Net counts under the known weight, summed over all channels
+  HX711Frame average;
+  averager.take(average);
+  averaging_job = JOB_NONE;
+  int32_t net = 0;
+  for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+    net += average.raw[c] - config.tareOffset[c];
+  }
 
-  int startX = 240;
-  int startY = 40;
-  int keyW = 60;
-  int keyH = 40;
-  int spacing = 10;
-
-  for (int row = 0; row < 4; row++) {
-    for (int col = 0; col < 3; col++) {
-      int x = startX + col * (keyW + spacing);
-      int y = startY + row * (keyH + spacing);
-
-      // Draw key
-      tft.fillRect(x, y, keyW, keyH, BLUE);
-      tft.drawRect(x, y, keyW, keyH, WHITE);
-      tft.setTextColor(WHITE);
-      tft.setTextSize(2);
-      tft.setCursor(x + 20, y + 10);
-      tft.print(keys[row][col]);
-    }
+  bool added = curve.addPoint(net, calibration_known_weight);
+  showCalibrationPoints(added ? "Point added" : "Not added");
+
+  enteredWeight.clear();
+  tft.fillRect(21, 141, 198, 28, BLACK);
+}
+
+// "Points: N/8" and a note about the last point, below the input field
+void showCalibrationPoints(const char *note) {
+  char text[DISPLAY_FIELD_MAX_CHARS + 1];
+  tft.fillRect(0, 185, 230, 60, BLACK);
+  tft.setTextColor(WHITE);
+  tft.setTextSize(2);
+  tft.setCursor(20, 190);
+  tft.print("Points: ");
+  formatDecimal(text, curve.pointCount(), 0);
+  tft.print(text);
+  tft.print('/');
+  formatDecimal(text, CAL_CURVE_MAX_POINTS, 0);
+  tft.print(text);
+  tft.setCursor(20, 220);
+  tft.setTextColor(GREEN);
+  tft.print(note);
+}
+
+// Done: save the points measured as the new calibration
+void applyCalibration() {
+  if (curve.pointCount() == 0) {
+    // Nothing measured, keep the calibration as it was
+    curve.begin();
+    pages.show(&main_page);
+    return;
   }
 
-  // Clear (C) button
-  int x = startX;
-  int y = startY + 4 * (keyH + spacing);
-  tft.fillRect(x, y, keyW * 3 + spacing * 2, keyH, RED);
-  tft.drawRect(x, y, keyW * 3 + spacing * 2, keyH, WHITE);
+  // Calculate the new calibration factor (counts per kg, fixed point)
+  // from the point furthest from zero. The cells share it, so they can be
+  // trimmed individually in EEPROM afterwards. It converts the axle
+  // weights, and with a single point the gross weight too.
+  int32_t counts, grams;
+  curve.widestPoint(counts, grams);
+  int32_t factor = (int64_t) counts * (1000L << CAL_FACTOR_FRAC_BITS) / grams;
+  for (uint8_t c = 0; c < CHANNEL_COUNT; c++) {
+    config.calibrationFactor[c] = factor;
+  }
+
+  // Update the conversion with the new calibration factor
+  updateConversion();
+
+  // Save the calibration factors and the curve to EEPROM
+  configStore.save(config);
+  curve.save();
+
+  pages.show(&calibrated_page);
+}
+
+// "Weight calibrated" and the number of points, for a few seconds
+void calibratedEnter() {
   tft.setTextColor(WHITE);
   tft.setTextSize(2);
-  tft.setCursor(x + (keyW * 3 + spacing * 2) / 2 - 15, y + 10);
-  tft.print("C");
+  tft.setCursor(20, 110);
+  char text[DISPLAY_FIELD_MAX_CHARS + 1];
+  formatDecimal(text, curve.pointCount(), 0);
+  tft.print(text);
+  tft.print(curve.pointCount() == 1 ? " point" : " points");
+  calibration_confirmed_at = millis();
 }
 
-char getKeypadInput(int x, int y) {
-  // Define keypad buttons
-  const char keys[4][3] = {
-    {'1', '2', '3'},
-    {'4', '5', '6'},
-    {'7', '8', '9'},
-    {'.', '0', 'E'} // E for Enter
+void calibratedPoll() {
+  if (millis() - calibration_confirmed_at >= CALIBRATION_CONFIRM_TIME) {
+    pages.show(&main_page);
+  }
+}
+
+// Copy src into dst right-aligned in a field of width characters
+static char *padLeft(char *dst, const char *src, uint8_t width) {
+  uint8_t len = strlen(src);
+  while (len < width) {
+    *dst++ = ' ';
+    width--;
+  }
+  strcpy(dst, src);
+  return dst + len;
+}
+
+void statsEnter() {
+  updateStats(false);
+}
+
+void statsUpdate() {
+  updateStats(true);
+}
+
+// One row per statistic and a column per aggregate, drawn opaque so
+// each refresh overwrites the previous values (the first, onto the
+// cleared page, only needs the ink)
+void updateStats(bool opaque) {
+  static const char labels[6][8] = { "loads", "total", "mean", "std dev", "min", "max" };
+  const LoadStats *columns[4] = {
+    &shiftStats.shift(), &shiftStats.day(), &shiftStats.previousShift(), &shiftStats.previousDay()
   };
+  char line[48];
+  char num[DISPLAY_FIELD_MAX_CHARS + 1];
 
-  int startX = 240;
-  int startY = 40;
-  int keyW = 60;
-  int keyH = 40;
-  int spacing = 10;
-
-  for (int row = 0; row < 4; row++) {
-    for (int col = 0; col < 3; col++) {
-      int btnX = startX + col * (keyW + spacing);
-      int btnY = startY + row * (keyH + spacing);
-      if (x > btnX && x < (btnX + keyW) && y > btnY && y < (btnY + keyH)) {
-        return keys[row][col];
+  tft.setTextColor(GREEN, opaque ? BLACK : GREEN);
+  tft.setTextSize(2);
+  for (uint8_t row = 0; row < 6; row++) {
+    strcpy(line, labels[row]);
+    char *end = line + strlen(line);
+    while (end < line + 7) {
+      *end++ = ' ';
+    }
+    for (uint8_t col = 0; col < 4; col++) {
+      const LoadStats &s = *columns[col];
+      int64_t grams;
+      switch (row) {
+        case 0:  grams = -1; break;
+        case 1:  grams = s.sum; break;
+        case 2:  grams = s.mean(); break;
+        case 3:  grams = s.deviation(); break;
+        case 4:  grams = s.min; break;
+        default: grams = s.max; break;
       }
+      if (row == 0) {
+        formatDecimal(num, s.count, 0);
+      } else if (s.count == 0 || (row == 3 && s.count < 2)) {
+        strcpy(num, "-");
+      } else {
+        formatDecimal(num, roundedDiv(grams, 100000), 1);
+      }
+      end = padLeft(end, num, 8);
     }
+    tft.setCursor(6, 70 + 25 * row);
+    tft.print(line);
   }
+}
+
+#if PROFILER_ENABLED
+void diagnosticsEnter() {
+  updateDiagnostics(false);
+}
+
+void diagnosticsUpdate() {
+  updateDiagnostics(true);
+}
 
-  // Check Clear (C) button
-  int btnX = startX;
-  int btnY = startY + 4 * (keyH + spacing);
-  int btnW = keyW * 3 + spacing * 2;
-  int btnH = keyH;
-  if (x > btnX && x < (btnX + btnW) && y > btnY && y < (btnY + btnH)) {
-    return 'C';
+// One row per section, drawn with an opaque background so each refresh
+// overwrites the previous values without a clear (but the first)
+void updateDiagnostics(bool opaque) {
+  char line[32];
+  char num[DISPLAY_FIELD_MAX_CHARS + 1];
+  ProfileReport r;
+
+  tft.setTextColor(GREEN, opaque ? BLACK : GREEN);
+  tft.setTextSize(2);
+  for (uint8_t i = 0; i < profiler.sectionCount(); i++) {
+    profiler.report(i, r);
+
+    char *end = line;
+    const char *name = profiler.section(i).name;
+    while (*name && end < line + 9) {
+      *end++ = *name++;
+    }
+    while (end < line + 9) {
+      *end++ = ' ';
+    }
+    formatDecimal(num, r.avg, 0);
+    end = padLeft(end, num, 6);
+    formatDecimal(num, r.max, 0);
+    end = padLeft(end, num, 6);
+    formatDecimal(num, r.overruns, 0);
+    padLeft(end, num, 6);
+
+    tft.setCursor(10, 70 + 25 * i);
+    tft.print(line);
+  }
+}
+#endif
+
+// Start an entry off with the value it edits, in kg (nothing for zero)
+static void fillEntry(KeypadEntry &entry, int32_t grams) {
+  char text[DISPLAY_FIELD_MAX_CHARS + 1];
+  entry.clear();
+  if (grams <= 0) {
+    return;
+  }
+  uint8_t len = formatDecimal(text, grams, 3);
+  while (text[len - 1] == '0') {
+    len--;
+  }
+  if (text[len - 1] == '.') {
+    len--;
   }
+  for (uint8_t i = 0; i < len; i++) {
+    entry.press(text[i]);
+  }
+}
 
-  return 0; // No key pressed
+// The settings page, filled in from the config; the overload margin is
+// entered as if it were kg, so whole percent come back as 1000s
+void settingsEnter() {
+  fillEntry(settingEntries[SETTING_TARGET], config.targetPayload);
+  fillEntry(settingEntries[SETTING_MARGIN], (int32_t) config.overloadPercent * 1000);
+  setting_field = SETTING_TARGET;
+  drawSettingsField(SETTING_TARGET);
+  drawSettingsField(SETTING_MARGIN);
 }
 
-// EEPROM read/write functions
-void EEPROMWriteInt(int address, int value) {
-  byte lowByte = value & 0xFF;
-  byte highByte = (value >> 8) & 0xFF;
-  EEPROM.update(address, lowByte);
-  EEPROM.update(address + 1, highByte);
+// The field being edited has a white frame, the other a blue one
+void drawSettingsField(uint8_t field) {
+  int16_t y = SETTING_FIELD_Y(field);
+  tft.fillRect(SETTING_FIELD_X + 1, y + 1, SETTING_FIELD_W - 2, SETTING_FIELD_H - 2, BLACK);
+  tft.drawRect(SETTING_FIELD_X, y, SETTING_FIELD_W, SETTING_FIELD_H, field == setting_field ? WHITE : BLUE);
+  tft.setTextColor(GREEN);
+  tft.setTextSize(2);
+  tft.setCursor(SETTING_FIELD_X + 5, y + 5);
+  tft.print(settingEntries[field].text());
 }
 
-int EEPROMReadInt(int address) {
-  byte lowByte = EEPROM.read(address);
-  byte highByte = EEPROM.read(address + 1);
-  return (highByte << 8) | lowByte;
+void settingsTouch(int16_t x, int16_t y, uint8_t action) {
+  char key = action;
+  KeypadEntry &entry = settingEntries[setting_field];
+  int32_t grams;
+  if (key == 'D') {
+    config.targetPayload = settingEntries[SETTING_TARGET].toGrams(grams) ? grams : 0;
+    if (settingEntries[SETTING_MARGIN].toGrams(grams)) {
+      config.overloadPercent = grams / 1000 > 255 ? 255 : grams / 1000;
+    } else {
+      config.overloadPercent = 0;
+    }
+    configStore.save(config);
+    updateAlarm();
+    pages.show(&main_page);
+  } else if (key == 'E') {
+    setting_field = setting_field == SETTING_TARGET ? SETTING_MARGIN : SETTING_TARGET;
+    drawSettingsField(SETTING_TARGET);
+    drawSettingsField(SETTING_MARGIN);
+  } else if (key != 0 && (entry.press(key) || key == 'C')) {
+    drawSettingsField(setting_field);
+  }
 }
 
-void EEPROMWriteFloat(int address, float value) {
-  byte *floatBytes = (byte *) &value;
+// Legacy settings, read once to migrate them to the config block and the
+// journal
+int32_t EEPROMReadLong(int address) {
+  uint32_t value = 0;
   for (int i = 0; i < 4; i++) {
-    EEPROM.update(address + i, floatBytes[i]);
+    value |= (uint32_t) EEPROM.read(address + i) << (8 * i);
   }
+  return (int32_t) value;
 }
 
-float EEPROMReadFloat(int address) {
-  float value = 0.0;
-  byte *floatBytes = (byte *) &value;
-  for (int i = 0; i < 4; i++) {
-    floatBytes[i] = EEPROM.read(address + i);
+int64_t EEPROMReadLongLong(int address) {
+  uint64_t low = (uint32_t) EEPROMReadLong(address);
+  uint64_t high = (uint32_t) EEPROMReadLong(address + 4);
+  return (int64_t) (low | high << 32);
+}
+
+// An IEEE float written by the first firmware, times 2^shift and rounded.
+// Decoded by hand so the soft-float library isn't linked in for it. False
+// for NaN (an erased cell), infinities and anything past 2^53.
+bool EEPROMReadFloat(int address, uint8_t shift, int64_t &value) {
+  uint32_t bits = (uint32_t) EEPROMReadLong(address);
+  int exponent = (bits >> 23) & 0xFF;
+  if (exponent == 0xFF) {
+    return false;
+  }
+  if (exponent == 0) {  // Zero or denormal
+    value = 0;
+    return true;
+  }
+  int64_t mantissa = (bits & 0x7FFFFFUL) | 0x800000UL;
+  int e = exponent - 150 + shift;  // value = mantissa * 2^e
+  if (e > 29) {
+    return false;
+  }
+  if (e >= 0) {
+    value = mantissa << e;
+  } else if (e > -25) {
+    value = (mantissa + (1L << (-e - 1))) >> -e;
+  } else {
+    value = 0;
+  }
+  if (bits & 0x80000000UL) {
+    value = -value;
+  }
+  return true;
+}
+
+// The totals as the integer firmware kept them, or else as floats. Erased
+// cells read as all ones, i.e. a negative count or NaN.
+bool readLegacyTotals(uint16_t &count, int64_t &grams) {
+  int16_t n = (int16_t) (EEPROM.read(EEPROM_LOAD_COUNT_ADDR) | EEPROM.read(EEPROM_LOAD_COUNT_ADDR + 1) << 8);
+  int64_t total = EEPROMReadLongLong(EEPROM_TOTAL_WEIGHT_ADDR);
+  if (n >= 0 && total >= 0) {
+    count = n;
+    grams = total;
+    return true;
+  }
+  n = (int16_t) (EEPROM.read(EEPROM_FLOAT_COUNT_ADDR) | EEPROM.read(EEPROM_FLOAT_COUNT_ADDR + 1) << 8);
+  if (n >= 0 && EEPROMReadFloat(EEPROM_FLOAT_TOTAL_ADDR, 10, total) && total >= 0) {
+    count = n;
+    grams = (total * 1000 + 512) >> 10;
+    return true;
   }
-  return value;
+  return false;
 }
@@ -0,0 +1,66 @@
+#include "page.h"
+
+typedef void (*PageHandler)();
+typedef void (*PageTouchHandler)(int16_t x, int16_t y, uint8_t action);
+
+PageManager::PageManager(TrackedDisplay &display, uint16_t ink) : display(display), ink(ink), current(0) {
+}
+
+void PageManager::show(const Page *page) {
+  Page p;
+  memcpy_P(&p, page, sizeof(p));
+  current = page;
+
+  display.clearDrawn();
+  for (uint8_t i = 0; i < p.textCount; i++) {
+    PageText t;
+    memcpy_P(&t, &p.texts[i], sizeof(t));
+    display.setTextColor(t.color);
+    display.setTextSize(t.size);
+    display.setCursor(t.x, t.y);
+    char c;
+    for (const char *s = t.text; (c = pgm_read_byte(s)) != '\0'; s++) {
+      display.write(c);
+    }
+  }
+  if (p.buttonCount > 0) {
+    drawWidgets(display, p.buttons, p.buttonCount, ink);
+  }
+  if (p.grid) {
+    drawGrid(display, p.grid, ink);
+  }
+  if (p.enter) {
+    p.enter();
+  }
+}
+
+void PageManager::update() {
+  PageHandler fn = current ? (PageHandler) pgm_read_ptr(&current->update) : 0;
+  if (fn) {
+    fn();
+  }
+}
+
+void PageManager::poll() {
+  PageHandler fn = current ? (PageHandler) pgm_read_ptr(&current->poll) : 0;
+  if (fn) {
+    fn();
+  }
+}
+
+void PageManager::touch(int16_t x, int16_t y) {
+  if (!current) {
+    return;
+  }
+  PageTouchHandler fn = (PageTouchHandler) pgm_read_ptr(&current->touch);
+  if (!fn) {
+    return;
+  }
+  const Widget *buttons = (const Widget *) pgm_read_ptr(&current->buttons);
+  const WidgetGrid *grid = (const WidgetGrid *) pgm_read_ptr(&current->grid);
+  uint8_t action = hitWidget(buttons, pgm_read_byte(&current->buttonCount), x, y);
+  if (action == WIDGET_NONE && grid) {
+    action = hitGrid(grid, x, y);
+  }
+  fn(x, y, action);
+}
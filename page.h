@@ -0,0 +1,66 @@
+/**
+ * Table-driven pages for the touchscreen UI.
+ *
+ * Each page is a const Page descriptor in flash (PROGMEM): its static
+ * layout -- text labels, a Widget table and optionally a WidgetGrid, as
+ * in widget.h -- and the handlers that bring it to life. The manager
+ * keeps a pointer to the page on screen, and every task hook is one
+ * handler pointer read from the descriptor and called, so the cost per
+ * scheduler pass is the same however many pages there are.
+ *
+ *   show(page)  clears what the last page drew (TrackedDisplay), draws
+ *               the layout, then calls enter() for the dynamic parts
+ *   update()    from the display task, to refresh values
+ *   poll()      from the touch task, for timeouts and background work
+ *   touch(x, y) a new press, with the action of the widget or key under
+ *               it (WIDGET_NONE if none)
+ *
+ * Any handler may be null. Label text is PROGMEM too, and is read a byte
+ * at a time while it is drawn.
+ */
+
+#ifndef PAGE_H
+#define PAGE_H
+
+#include "tracked_display.h"
+#include "widget.h"
+
+struct PageText {
+  int16_t x;
+  int16_t y;
+  uint8_t size;
+  uint16_t color;
+  const char *text;  // PROGMEM
+};
+
+struct Page {
+  const PageText *texts;
+  uint8_t textCount;
+  const Widget *buttons;
+  uint8_t buttonCount;
+  const WidgetGrid *grid;  // null if none
+  void (*enter)();
+  void (*update)();
+  void (*poll)();
+  void (*touch)(int16_t x, int16_t y, uint8_t action);
+};
+
+class PageManager {
+public:
+  // Widgets are drawn with ink borders and labels
+  PageManager(TrackedDisplay &display, uint16_t ink);
+
+  void show(const Page *page);
+  bool showing(const Page *page) const { return current == page; }
+
+  void update();
+  void poll();
+  void touch(int16_t x, int16_t y);
+
+private:
+  TrackedDisplay &display;
+  uint16_t ink;
+  const Page *current;  // null until the first show()
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "power_manager.h"
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+// The core's millisecond count (wiring.c), which stands still in power-down
+extern "C" volatile unsigned long timer0_millis;
+
+// Only there to wake the MCU
+ISR(WDT_vect) {
+}
+
+void powerDownSleep() {
+  noInterrupts();
+  wdt_reset();
+  MCUSR &= ~bit(WDRF);
+  WDTCSR = bit(WDCE) | bit(WDE);
+  WDTCSR = bit(WDIE) | bit(WDP2) | bit(WDP0);  // interrupt after 0.5 s
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sleep_enable();
+#ifdef sleep_bod_disable
+  sleep_bod_disable();
+#endif
+  interrupts();
+  sleep_cpu();
+  sleep_disable();
+  wdt_disable();
+
+  noInterrupts();
+  timer0_millis += POWER_SLEEP_MS;
+  interrupts();
+}
+#endif
+
+PowerManager::PowerManager(const PowerConfig &config)
+  : cfg(config), powerState(POWER_ACTIVE), reference(0), referenced(false), sampled(false),
+    activeAt(0), checkAt(0) {
+}
+
+void PowerManager::begin(unsigned long now) {
+  powerState = POWER_ACTIVE;
+  referenced = false;
+  activeAt = now;
+}
+
+bool PowerManager::activity(unsigned long now) {
+  activeAt = now;
+  if (powerState == POWER_ACTIVE) {
+    return false;
+  }
+  powerState = POWER_ACTIVE;
+  return true;
+}
+
+bool PowerManager::sample(int32_t grams, unsigned long now) {
+  sampled = true;
+  if (!referenced) {
+    reference = grams;
+    referenced = true;
+  }
+  int32_t change = grams - reference;
+  if (change < cfg.wakeBand && change > -cfg.wakeBand) {
+    return false;
+  }
+  reference = grams;
+  return activity(now);
+}
+
+bool PowerManager::idleDue(unsigned long now) const {
+  return powerState == POWER_ACTIVE && now - activeAt >= cfg.idleAfter;
+}
+
+void PowerManager::sleep() {
+  powerDownSleep();
+  powerState = POWER_CHECKING;
+  sampled = false;
+  checkAt = millis();
+}
+
+bool PowerManager::checkDone(unsigned long now) const {
+  return powerState == POWER_CHECKING && (sampled || now - checkAt >= cfg.checkTimeout);
+}
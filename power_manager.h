@@ -0,0 +1,82 @@
+/**
+ * Idle mode for a parked truck.
+ *
+ * After idleAfter ms with no activity -- no weight change of wakeBand or
+ * more, no touch, no serial request -- the sketch may go idle: it powers
+ * the HX711s down, dims the backlight and puts the MCU to sleep. It then
+ * wakes every POWER_SLEEP_MS on the watchdog timer for a check: the HX711s
+ * are powered up, and the first conversion after they settle (or a touch)
+ * decides whether to stay awake or sleep again. A check costs the settling
+ * time plus one conversion, ~65 ms at 80 SPS.
+ *
+ *   ACTIVE   --idleDue() and the sketch is quiet--> sleep() --> CHECKING
+ *   CHECKING --checkDone()-->                        sleep() --> CHECKING
+ *   CHECKING --sample() off by wakeBand, activity()-----------> ACTIVE
+ *
+ * The manager only keeps the state and the timing; the sketch switches the
+ * peripherals around sleep(). Wake latency is at most one sleep period
+ * plus a check.
+ *
+ * sleep() uses power-down mode with the watchdog in interrupt mode, so it
+ * disables the watchdog's reset on the way out: re-arm it afterwards.
+ * millis() stops while the MCU sleeps and is advanced by the time slept.
+ * On the host build the simulator provides powerDownSleep() (sim_hw.cpp).
+ */
+
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+
+#define POWER_SLEEP_MS 500  // one watchdog period
+
+// Sleep in power-down mode for about POWER_SLEEP_MS
+void powerDownSleep();
+
+struct PowerConfig {
+  uint32_t idleAfter;     // ms without activity
+  uint16_t checkTimeout;  // ms a check waits for a conversion
+  int32_t wakeBand;       // grams
+};
+
+enum PowerState {
+  POWER_ACTIVE,
+  POWER_CHECKING
+};
+
+class PowerManager {
+public:
+  explicit PowerManager(const PowerConfig &config);
+
+  void begin(unsigned long now);
+
+  // Touch, a serial request... Returns true if it ended idle mode.
+  bool activity(unsigned long now);
+
+  // Every weight (gross, unfiltered). Returns true if it ended idle mode.
+  bool sample(int32_t grams, unsigned long now);
+
+  // No activity for idleAfter
+  bool idleDue(unsigned long now) const;
+
+  // Sleep one period; the sketch has powered everything down
+  void sleep();
+
+  // The check after a sleep has its conversion (or gave up waiting)
+  bool checkDone(unsigned long now) const;
+
+  PowerState state() const { return powerState; }
+  bool idle() const { return powerState != POWER_ACTIVE; }
+  const PowerConfig &config() const { return cfg; }
+
+private:
+  const PowerConfig &cfg;
+  PowerState powerState;
+  int32_t reference;  // grams, where the weight last settled
+  bool referenced;
+  bool sampled;       // a conversion since the last sleep
+  unsigned long activeAt;
+  unsigned long checkAt;
+};
+
+#endif
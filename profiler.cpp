@@ -0,0 +1,45 @@
+#include "profiler.h"
+
+#if PROFILER_ENABLED
+
+static uint16_t ticksToMicros(uint32_t ticks) {
+  uint32_t us = ticks * PROFILER_TICK_US;
+  return us > 0xFFFF ? 0xFFFF : us;
+}
+
+Profiler::Profiler(ProfileSection *sections, uint8_t count) : sections(sections), count(count) {
+}
+
+void Profiler::begin() {
+#if defined(__AVR__)
+  // Timer1 free running, normal mode, clk/64; nothing else in the sketch uses it
+  TCCR1A = 0;
+  TCCR1B = _BV(CS11) | _BV(CS10);
+  TIMSK1 = 0;
+#endif
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t ticks = sections[i].budget / PROFILER_TICK_US;
+    sections[i].budgetTicks = ticks > 0xFFFF ? 0xFFFF : ticks;
+    sections[i].overruns = 0;
+    restart(i);
+  }
+}
+
+void Profiler::report(uint8_t id, ProfileReport &out) const {
+  const ProfileSection &s = sections[id];
+  out.count = s.count;
+  out.min = s.count ? ticksToMicros(s.min) : 0;
+  out.max = ticksToMicros(s.max);
+  out.avg = s.count ? ticksToMicros(s.total / s.count) : 0;
+  out.overruns = s.overruns;
+}
+
+void Profiler::restart(uint8_t id) {
+  ProfileSection &s = sections[id];
+  s.count = 0;
+  s.total = 0;
+  s.min = 0xFFFF;
+  s.max = 0;
+}
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * Scoped hot-path probes.
+ *
+ * The sketch owns a table of named sections, each with a time budget. A
+ * PROFILE_SCOPE() at the top of a block reads a free-running timer on entry
+ * and exit and folds the elapsed time into that section's count, min, max
+ * and total for the current window, and counts an overrun whenever the
+ * budget is exceeded. A probe is two timer reads and a handful of compares,
+ * so it can stay compiled in on units in the field.
+ *
+ * On AVR the clock is Timer1 running free at F_CPU/64 (4 us ticks at
+ * 16 MHz), elsewhere micros(). Elapsed times are 16-bit, so a section that
+ * runs longer than 65535 ticks (~262 ms) wraps; the scheduler's lateness
+ * tracking covers anything that slow.
+ *
+ * Build option: PROFILER_ENABLED. Set it to 0 here (or -DPROFILER_ENABLED=0)
+ * and every probe compiles to nothing.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#if PROFILER_ENABLED
+
+#if defined(__AVR__)
+#define PROFILER_TICK_US (64 / (F_CPU / 1000000UL))
+static inline uint16_t profilerTicks() { return TCNT1; }
+#else
+#define PROFILER_TICK_US 4
+static inline uint16_t profilerTicks() { return micros() / PROFILER_TICK_US; }
+#endif
+
+struct ProfileSection {
+  const char *name;
+  uint16_t budget;        // us; a longer run counts as an overrun
+
+  // Maintained by the profiler; all but overruns restart with each window
+  uint32_t count;
+  uint32_t total;         // ticks
+  uint16_t min;           // ticks
+  uint16_t max;           // ticks
+  uint16_t overruns;
+  uint16_t budgetTicks;
+};
+
+// Window statistics in microseconds, as reported
+struct ProfileReport {
+  uint32_t count;
+  uint16_t min;
+  uint16_t max;
+  uint16_t avg;
+  uint16_t overruns;
+};
+
+class Profiler {
+public:
+  Profiler(ProfileSection *sections, uint8_t count);
+
+  // Start the timer and clear all statistics; call once from setup().
+  void begin();
+
+  void record(uint8_t id, uint16_t ticks) {
+    ProfileSection &s = sections[id];
+    s.count++;
+    s.total += ticks;
+    if (ticks < s.min) {
+      s.min = ticks;
+    }
+    if (ticks > s.max) {
+      s.max = ticks;
+    }
+    if (ticks > s.budgetTicks && s.overruns < 0xFFFF) {
+      s.overruns++;
+    }
+  }
+
+  // Statistics of the current window, without clearing them
+  void report(uint8_t id, ProfileReport &out) const;
+
+  // Start a new window for one section (overruns keep counting)
+  void restart(uint8_t id);
+
+  uint8_t sectionCount() const { return count; }
+  const ProfileSection &section(uint8_t id) const { return sections[id]; }
+
+private:
+  ProfileSection *sections;
+  uint8_t count;
+};
+
+class ProfileProbe {
+public:
+  ProfileProbe(Profiler &profiler, uint8_t id) : profiler(profiler), id(id), start(profilerTicks()) {}
+  ~ProfileProbe() { profiler.record(id, profilerTicks() - start); }
+
+private:
+  Profiler &profiler;
+  uint8_t id;
+  uint16_t start;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(profiler, id) ProfileProbe PROFILE_CONCAT(profile_probe_, __LINE__)(profiler, id)
+
+#else
+
+#define PROFILE_SCOPE(profiler, id)
+
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+/**
+ * Lock-free single-producer / single-consumer ring buffer.
+ *
+ * The producer (typically an ISR) only ever writes the head index and the
+ * consumer (loop()) only ever writes the tail index. Indices are uint8_t so
+ * every access is a single, atomic byte load/store on the AVR and no
+ * interrupt masking is needed on either side.
+ *
+ * Capacity must be a power of two; one slot is kept free to tell a full
+ * buffer from an empty one, so a RingBuffer<T, 16> holds 15 elements.
+ */
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stdint.h>
+
+// Compiler barrier: keeps element stores/loads from being reordered across
+// the index update that publishes them.
+#define RING_BUFFER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+template <typename T, uint8_t N>
+class RingBuffer {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "RingBuffer size must be a power of two");
+
+public:
+  RingBuffer() : head(0), tail(0) {}
+
+  // Producer side. Returns false (and drops the element) when full.
+  bool push(const T &value) {
+    uint8_t h = head;
+    uint8_t next = (h + 1) & (N - 1);
+    if (next == tail) {
+      return false;
+    }
+    items[h] = value;
+    RING_BUFFER_BARRIER();
+    head = next;
+    return true;
+  }
+
+  // Consumer side. Returns false when empty.
+  bool pop(T &value) {
+    uint8_t t = tail;
+    if (t == head) {
+      return false;
+    }
+    value = items[t];
+    RING_BUFFER_BARRIER();
+    tail = (t + 1) & (N - 1);
+    return true;
+  }
+
+  // Consumer side. Copies the oldest element without removing it.
+  bool peek(T &value) const {
+    uint8_t t = tail;
+    if (t == head) {
+      return false;
+    }
+    value = items[t];
+    return true;
+  }
+
+  bool empty() const { return head == tail; }
+  uint8_t size() const { return (head - tail) & (N - 1); }
+  uint8_t space() const { return (N - 1) - size(); }
+
+  // Only safe to call while the producer is stopped.
+  void clear() { tail = head; }
+
+private:
+  T items[N];
+  volatile uint8_t head;
+  volatile uint8_t tail;
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include "sample_codec.h"
+
+uint8_t varintSize(uint32_t v) {
+  uint8_t n = 1;
+  while (v >= 0x80) {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+uint8_t putVarint(uint8_t *dst, uint32_t v) {
+  uint8_t n = 0;
+  while (v >= 0x80) {
+    dst[n++] = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  dst[n++] = v;
+  return n;
+}
+
+uint8_t getVarint(const uint8_t *src, uint16_t len, uint32_t &v) {
+  v = 0;
+  for (uint8_t i = 0; i < VARINT_MAX_BYTES && i < len; i++) {
+    v |= (uint32_t) (src[i] & 0x7F) << (7 * i);
+    if ((src[i] & 0x80) == 0) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
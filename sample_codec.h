@@ -0,0 +1,59 @@
+/**
+ * Compact encoding for runs of HX711 readings, shared by the SD history
+ * (bulk_log.h), the telemetry sample batches (telemetry.h) and the host
+ * decoder (sim/decode.cpp).
+ *
+ * A run starts with its first value in full; every value after that is
+ * the difference from the one before, zig-zag mapped (0, -1, 1, -2, ... ->
+ * 0, 1, 2, 3, ...) so small changes either way stay small, then written
+ * as a varint: 7 bits per byte, low bits first, the top bit set on every
+ * byte but the last. On an empty or steady scale the reading moves by a
+ * few counts per conversion, so most deltas take one byte instead of four.
+ *
+ *   delta    bytes
+ *   +-63     1
+ *   +-8191   2
+ *   +-2^20   3
+ *   else     4-5
+ *
+ * No state beyond the previous value, and no tables.
+ */
+
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include <stdint.h>
+
+#define VARINT_MAX_BYTES 5  // a 32-bit value
+
+inline uint32_t zigzagEncode(int32_t v) {
+  return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+}
+
+inline int32_t zigzagDecode(uint32_t v) {
+  return (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+}
+
+// Bytes putVarint() would write for v
+uint8_t varintSize(uint32_t v);
+
+// Write v at dst, returning the bytes written
+uint8_t putVarint(uint8_t *dst, uint32_t v);
+
+// Read a varint from at most len bytes at src into v. Returns the bytes
+// used, or 0 if it is truncated or too long.
+uint8_t getVarint(const uint8_t *src, uint16_t len, uint32_t &v);
+
+// The delta step of a run: encodes value against previous (which becomes
+// value), returning the bytes written
+inline uint8_t putDelta(uint8_t *dst, int32_t &previous, int32_t value) {
+  uint8_t n = putVarint(dst, zigzagEncode(value - previous));
+  previous = value;
+  return n;
+}
+
+inline uint8_t deltaSize(int32_t previous, int32_t value) {
+  return varintSize(zigzagEncode(value - previous));
+}
+
+#endif
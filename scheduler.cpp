@@ -0,0 +1,45 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler(Task *tasks, uint8_t count) : tasks(tasks), count(count) {
+}
+
+void Scheduler::begin() {
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < count; i++) {
+    tasks[i].due = now;
+    tasks[i].overruns = 0;
+    tasks[i].worstLateness = 0;
+  }
+}
+
+void Scheduler::run() {
+  for (uint8_t i = 0; i < count; i++) {
+    Task &t = tasks[i];
+    unsigned long now = millis();
+    if ((long) (now - t.due) < 0) {
+      continue;
+    }
+
+    t.run();
+
+    unsigned long lateness = millis() - t.due;
+    if (lateness > t.worstLateness) {
+      t.worstLateness = lateness > 0xFFFF ? 0xFFFF : lateness;
+    }
+    if (lateness > t.deadline && t.overruns < 0xFFFF) {
+      t.overruns++;
+    }
+
+    // Keep a steady cadence, but don't try to catch up on missed periods
+    t.due += t.period;
+    if ((long) (now - t.due) >= 0) {
+      t.due = now + t.period;
+    }
+  }
+}
+
+void Scheduler::pause(unsigned long ms) {
+  for (uint8_t i = 0; i < count; i++) {
+    tasks[i].due += ms;
+  }
+}
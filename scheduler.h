@@ -0,0 +1,54 @@
+/**
+ * Cooperative millis()-based task scheduler.
+ *
+ * Tasks live in a fixed table owned by the sketch. Each pass of run() calls
+ * every task whose period has elapsed, in table order, so the table order
+ * doubles as the priority. Tasks must return quickly; nothing preempts them.
+ *
+ * A run that finishes more than `deadline` ms after it was due counts as an
+ * overrun, which catches both tasks that start late (starved by a slow
+ * neighbour) and tasks that take too long themselves.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+typedef void (*TaskFunction)();
+
+struct Task {
+  const char *name;
+  TaskFunction run;
+  uint16_t period;        // ms between runs, 0 = every pass
+  uint16_t deadline;      // ms after the due time by which a run must finish
+
+  // Maintained by the scheduler
+  unsigned long due;
+  uint16_t overruns;
+  uint16_t worstLateness; // ms
+};
+
+class Scheduler {
+public:
+  Scheduler(Task *tasks, uint8_t count);
+
+  // Align all tasks to start now; call once at the end of setup().
+  void begin();
+
+  // Run every task that is due. Call from loop().
+  void run();
+
+  // The board slept for ms: move every due time on by as much, so the
+  // sleep counts against no task (including the one that slept)
+  void pause(unsigned long ms);
+
+  uint8_t taskCount() const { return count; }
+  const Task &task(uint8_t i) const { return tasks[i]; }
+
+private:
+  Task *tasks;
+  uint8_t count;
+};
+
+#endif
@@ -0,0 +1,204 @@
+#include "sd_card.h"
+#include <SPI.h>
+#include "crc8.h"
+
+// SPI mode commands
+#define SD_CMD0   0   // GO_IDLE_STATE
+#define SD_CMD8   8   // SEND_IF_COND
+#define SD_CMD16  16  // SET_BLOCKLEN
+#define SD_CMD17  17  // READ_SINGLE_BLOCK
+#define SD_CMD24  24  // WRITE_BLOCK
+#define SD_CMD55  55  // APP_CMD
+#define SD_CMD58  58  // READ_OCR
+#define SD_ACMD41 41  // SD_SEND_OP_COND
+
+#define R1_IDLE        0x01
+#define R1_ILLEGAL_CMD 0x04
+
+#define DATA_START_TOKEN 0xFE
+#define DATA_ACCEPTED    0x05
+
+// Start-up clocks at 250 kHz, everything after at the Uno's 8 MHz maximum
+#define SD_INIT_CLOCK 250000
+#define SD_FAST_CLOCK 8000000
+
+// ACMD41 keeps answering "idle" for up to a second on slow cards
+#define SD_START_TIMEOUT 1000   // ms
+#define SD_TOKEN_TRIES   2000   // bytes polled for a read's data token, ~2 ms
+
+SdCard::SdCard(uint8_t csPin)
+  : cs(csPin), state(SD_FAILED), blockAddressed(false), version2(false), startedAt(0) {
+}
+
+void SdCard::select() {
+  SPI.beginTransaction(SPISettings(state == SD_READY ? SD_FAST_CLOCK : SD_INIT_CLOCK, MSBFIRST, SPI_MODE0));
+  digitalWrite(cs, LOW);
+}
+
+void SdCard::deselect() {
+  digitalWrite(cs, HIGH);
+  SPI.transfer(0xFF);  // lets the card release MISO
+  SPI.endTransaction();
+}
+
+// Send a command frame and return its R1 response (0xFF if none came).
+// The CRC only matters for CMD0 and CMD8, the card ignores it after.
+uint8_t SdCard::command(uint8_t cmd, uint32_t arg) {
+  SPI.transfer(0xFF);
+  SPI.transfer(0x40 | cmd);
+  for (int8_t shift = 24; shift >= 0; shift -= 8) {
+    SPI.transfer(arg >> shift);
+  }
+  SPI.transfer(cmd == SD_CMD0 ? 0x95 : (cmd == SD_CMD8 ? 0x87 : 0x01));
+
+  uint8_t r1 = 0xFF;
+  for (uint8_t i = 0; i < 10 && (r1 & 0x80); i++) {
+    r1 = SPI.transfer(0xFF);
+  }
+  return r1;
+}
+
+bool SdCard::begin() {
+  state = SD_FAILED;
+  pinMode(cs, OUTPUT);
+  digitalWrite(cs, HIGH);
+  SPI.begin();
+
+  // 80 clocks with CS high put the card into native mode, ready for CMD0
+  SPI.beginTransaction(SPISettings(SD_INIT_CLOCK, MSBFIRST, SPI_MODE0));
+  for (uint8_t i = 0; i < 10; i++) {
+    SPI.transfer(0xFF);
+  }
+  SPI.endTransaction();
+
+  // Version 1 cards don't know CMD8; later ones echo its check pattern
+  select();
+  bool ok = command(SD_CMD0, 0) == R1_IDLE;
+  if (ok) {
+    uint8_t r1 = command(SD_CMD8, 0x1AA);
+    version2 = (r1 & R1_ILLEGAL_CMD) == 0;
+    if (version2) {
+      uint8_t r7 = 0;
+      for (uint8_t i = 0; i < 4; i++) {
+        r7 = SPI.transfer(0xFF);
+      }
+      ok = r1 == R1_IDLE && r7 == 0xAA;
+    }
+  }
+  deselect();
+
+  if (!ok) {
+    return false;
+  }
+  state = SD_STARTING;
+  startedAt = millis();
+  return true;
+}
+
+SdStartStatus SdCard::startUp() {
+  if (state != SD_STARTING) {
+    return state;
+  }
+
+  select();
+  command(SD_CMD55, 0);
+  uint8_t r1 = command(SD_ACMD41, version2 ? 0x40000000UL : 0);
+  if (r1 == 0) {
+    // Ready: an SDHC/SDXC card says so in the OCR's CCS bit
+    blockAddressed = false;
+    if (version2 && command(SD_CMD58, 0) == 0) {
+      blockAddressed = (SPI.transfer(0xFF) & 0x40) != 0;
+      for (uint8_t i = 0; i < 3; i++) {
+        SPI.transfer(0xFF);
+      }
+    }
+    if (!blockAddressed && command(SD_CMD16, SD_BLOCK_SIZE) != 0) {
+      r1 = 0xFF;
+    }
+  }
+  deselect();
+
+  if (r1 == 0) {
+    state = SD_READY;
+  } else if (r1 != R1_IDLE || millis() - startedAt > SD_START_TIMEOUT) {
+    state = SD_FAILED;
+  }
+  return state;
+}
+
+bool SdCard::read(uint32_t block, uint8_t *dst, uint16_t len, bool *crcOk, uint16_t offset) {
+  if (state != SD_READY) {
+    return false;
+  }
+
+  select();
+  bool ok = command(SD_CMD17, blockAddressed ? block : block * SD_BLOCK_SIZE) == 0;
+  if (ok) {
+    uint8_t token = 0xFF;
+    for (uint16_t i = 0; i < SD_TOKEN_TRIES && token == 0xFF; i++) {
+      token = SPI.transfer(0xFF);
+    }
+    ok = token == DATA_START_TOKEN;
+  }
+  if (ok) {
+    uint8_t crc = CRC8_INIT;
+    for (uint16_t i = 0; i < SD_BLOCK_SIZE; i++) {
+      uint8_t b = SPI.transfer(0xFF);
+      if (i >= offset && i - offset < len) {
+        dst[i - offset] = b;
+      }
+      if (i < SD_BLOCK_SIZE - 1) {
+        crc = crc8Update(crc, b);
+      } else if (crcOk) {
+        *crcOk = b == crc;
+      }
+    }
+    SPI.transfer(0xFF);  // the card's CRC-16, unchecked
+    SPI.transfer(0xFF);
+  }
+  deselect();
+  return ok;
+}
+
+bool SdCard::writeStart(uint32_t block) {
+  if (state != SD_READY) {
+    return false;
+  }
+  select();
+  if (command(SD_CMD24, blockAddressed ? block : block * SD_BLOCK_SIZE) != 0) {
+    deselect();
+    return false;
+  }
+  SPI.transfer(0xFF);
+  SPI.transfer(DATA_START_TOKEN);
+  return true;
+}
+
+void SdCard::writeData(const uint8_t *src, uint16_t len) {
+  while (len--) {
+    SPI.transfer(*src++);
+  }
+}
+
+void SdCard::writeByte(uint8_t b) {
+  SPI.transfer(b);
+}
+
+bool SdCard::writeEnd() {
+  SPI.transfer(0xFF);  // CRC-16, ignored in SPI mode
+  SPI.transfer(0xFF);
+  uint8_t response = SPI.transfer(0xFF);
+  deselect();
+  return (response & 0x1F) == DATA_ACCEPTED;
+}
+
+// The card holds MISO low until the block is programmed
+bool SdCard::busy() {
+  if (state != SD_READY) {
+    return false;
+  }
+  select();
+  bool b = SPI.transfer(0xFF) != 0xFF;
+  deselect();
+  return b;
+}
@@ -0,0 +1,72 @@
+/**
+ * Minimal SD card driver in SPI mode for raw 512-byte block access.
+ *
+ * No filesystem: blocks are addressed directly, so whatever was on the
+ * card is overwritten. Only what the bulk log needs is implemented --
+ * start-up, single block reads and single block writes -- which keeps it
+ * clear of the 512-byte cache and FAT code of the SD library.
+ *
+ * Nothing here waits for the card beyond a few bytes:
+ * - begin() resets the card and checks its version; the card then starts
+ *   up over repeated startUp() calls (one ACMD41 each, ~100 ms in all).
+ * - read() reads a block in one call (~1 ms at 8 MHz), keeping only the
+ *   bytes asked for, briefly polling for the data token.
+ * - A write is split up: writeStart(), any number of writeData() chunks
+ *   adding up to SD_BLOCK_SIZE bytes, writeEnd(); then busy() stays true
+ *   while the card programs the block (typically a few ms).
+ *
+ * SDSC cards are byte addressed and SDHC/SDXC block addressed; read() and
+ * writeStart() always take a block number.
+ */
+
+#ifndef SD_CARD_H
+#define SD_CARD_H
+
+#include <Arduino.h>
+
+#define SD_BLOCK_SIZE 512
+
+enum SdStartStatus {
+  SD_STARTING,
+  SD_READY,
+  SD_FAILED
+};
+
+class SdCard {
+public:
+  explicit SdCard(uint8_t csPin);
+
+  // Reset the card into SPI mode. Returns false if no card answers.
+  bool begin();
+
+  // One start-up attempt per call until the card is READY or FAILED
+  SdStartStatus startUp();
+  bool ready() const { return state == SD_READY; }
+
+  // Read block, keeping len bytes of it from offset in dst. If crcOk
+  // isn't null it tells whether the last byte is the CRC-8 (crc8.h) of the
+  // others, so a block framed that way can be checked without buffering
+  // all of it.
+  bool read(uint32_t block, uint8_t *dst, uint16_t len, bool *crcOk = 0, uint16_t offset = 0);
+
+  bool writeStart(uint32_t block);
+  void writeData(const uint8_t *src, uint16_t len);
+  void writeByte(uint8_t b);
+  bool writeEnd();  // false if the card rejected the block
+
+  // True while the card is still programming the last block written
+  bool busy();
+
+private:
+  uint8_t command(uint8_t cmd, uint32_t arg);
+  void select();
+  void deselect();
+
+  uint8_t cs;
+  SdStartStatus state;
+  bool blockAddressed;
+  bool version2;
+  unsigned long startedAt;
+};
+
+#endif
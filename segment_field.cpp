@@ -0,0 +1,106 @@
+#include "segment_field.h"
+
+// Segment bits, in the usual a-g order: a top, b upper right, c lower
+// right, d bottom, e lower left, f upper left, g middle, then the point
+#define SEG_A  0x01
+#define SEG_B  0x02
+#define SEG_C  0x04
+#define SEG_D  0x08
+#define SEG_E  0x10
+#define SEG_F  0x20
+#define SEG_G  0x40
+#define SEG_DP 0x80
+
+static const uint8_t digit_segments[10] PROGMEM = {
+  SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F,          // 0
+  SEG_B | SEG_C,                                          // 1
+  SEG_A | SEG_B | SEG_D | SEG_E | SEG_G,                  // 2
+  SEG_A | SEG_B | SEG_C | SEG_D | SEG_G,                  // 3
+  SEG_B | SEG_C | SEG_F | SEG_G,                          // 4
+  SEG_A | SEG_C | SEG_D | SEG_F | SEG_G,                  // 5
+  SEG_A | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G,          // 6
+  SEG_A | SEG_B | SEG_C,                                  // 7
+  SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G,  // 8
+  SEG_A | SEG_B | SEG_C | SEG_D | SEG_F | SEG_G,          // 9
+};
+
+static uint8_t charSegments(char c) {
+  if (c >= '0' && c <= '9') {
+    return pgm_read_byte(&digit_segments[c - '0']);
+  }
+  return c == '-' ? SEG_G : 0;
+}
+
+SegmentField::SegmentField(int16_t x, int16_t y, uint8_t cells, uint8_t digitW, uint8_t digitH,
+                           uint8_t thickness, uint16_t color, uint16_t background)
+  : x(x), y(y), cells(cells > SEGMENT_FIELD_MAX_CELLS ? SEGMENT_FIELD_MAX_CELLS : cells),
+    digitW(digitW), digitH(digitH), thickness(thickness), color(color), background(background),
+    valid(false) {
+}
+
+void SegmentField::invalidate() {
+  valid = false;
+}
+
+void SegmentField::cleared() {
+  memset(shown, 0, sizeof(shown));
+  valid = true;
+}
+
+// Fill the segments in mask of the cell starting at cx
+void SegmentField::drawSegments(Adafruit_GFX &gfx, int16_t cx, uint8_t mask, uint16_t ink) {
+  int16_t t = thickness;
+  int16_t barW = digitW - 2 * t;
+  int16_t mid = y + (digitH - t) / 2;  // top of the middle bar
+  int16_t upperH = mid - (y + t);
+  int16_t lowerH = (y + digitH - t) - (mid + t);
+
+  for (uint8_t seg = 0; seg < 8; seg++) {
+    if (!(mask & (1 << seg))) {
+      continue;
+    }
+    switch (1 << seg) {
+      case SEG_A:  gfx.fillRect(cx + t, y, barW, t, ink); break;
+      case SEG_B:  gfx.fillRect(cx + digitW - t, y + t, t, upperH, ink); break;
+      case SEG_C:  gfx.fillRect(cx + digitW - t, mid + t, t, lowerH, ink); break;
+      case SEG_D:  gfx.fillRect(cx + t, y + digitH - t, barW, t, ink); break;
+      case SEG_E:  gfx.fillRect(cx, mid + t, t, lowerH, ink); break;
+      case SEG_F:  gfx.fillRect(cx, y + t, t, upperH, ink); break;
+      case SEG_G:  gfx.fillRect(cx + t, mid, barW, t, ink); break;
+      case SEG_DP: gfx.fillRect(cx + digitW + 2, y + digitH - t, t, t, ink); break;
+    }
+  }
+}
+
+void SegmentField::show(Adafruit_GFX &gfx, const char *text) {
+  // Segments per cell, filled from the right
+  uint8_t masks[SEGMENT_FIELD_MAX_CELLS];
+  memset(masks, 0, sizeof(masks));
+  int8_t cell = cells - 1;
+  bool point = false;
+  for (int8_t i = strlen(text) - 1; i >= 0 && cell >= 0; i--) {
+    if (text[i] == '.') {
+      point = true;
+      continue;
+    }
+    masks[cell] = charSegments(text[i]) | (point ? SEG_DP : 0);
+    point = false;
+    cell--;
+  }
+
+  // Only the segments that changed are drawn
+  for (uint8_t c = 0; c < cells; c++) {
+    uint8_t old = valid ? shown[c] : 0xFF;
+    uint8_t on = masks[c] & ~(valid ? old : 0);
+    uint8_t off = old & ~masks[c];
+    int16_t cx = x + c * pitch();
+    if (off) {
+      drawSegments(gfx, cx, off, background);
+    }
+    if (on) {
+      drawSegments(gfx, cx, on, color);
+    }
+    shown[c] = masks[c];
+  }
+  valid = true;
+}
@@ -0,0 +1,57 @@
+/**
+ * Large seven-segment numeric field for the TFT.
+ *
+ * Digits are built from filled rectangles rather than scaled font glyphs:
+ * a digit is at most seven bars plus the decimal point, each one
+ * fillRect() (one address window and a run of pixels). Like DisplayField,
+ * the field remembers what it shows, but per segment: show() only fills
+ * the segments that turn on and blanks the ones that turn off, so a digit
+ * going from 8 to 9 costs a single bar.
+ *
+ * Text is right-aligned in the field. Digits, '-' and ' ' take a cell
+ * each; a '.' lights the decimal point of the digit before it.
+ */
+
+#ifndef SEGMENT_FIELD_H
+#define SEGMENT_FIELD_H
+
+#include <Adafruit_GFX.h>
+
+#define SEGMENT_FIELD_MAX_CELLS 8
+
+class SegmentField {
+public:
+  // Each of the cells is digitW x digitH pixels with bars thickness
+  // pixels wide; the gap between cells holds the decimal point
+  SegmentField(int16_t x, int16_t y, uint8_t cells, uint8_t digitW, uint8_t digitH,
+               uint8_t thickness, uint16_t color, uint16_t background);
+
+  // Forget what is on screen; the next show() paints every segment
+  void invalidate();
+
+  // The area has just been cleared; the next show() only fills the
+  // segments that are lit
+  void cleared();
+
+  void show(Adafruit_GFX &gfx, const char *text);
+
+  // Horizontal distance between cells, and the field's total width
+  uint8_t pitch() const { return digitW + thickness + 4; }
+  int16_t width() const { return cells * pitch(); }
+
+private:
+  void drawSegments(Adafruit_GFX &gfx, int16_t cx, uint8_t mask, uint16_t color);
+
+  int16_t x;
+  int16_t y;
+  uint8_t cells;
+  uint8_t digitW;
+  uint8_t digitH;
+  uint8_t thickness;
+  uint16_t color;
+  uint16_t background;
+  bool valid;
+  uint8_t shown[SEGMENT_FIELD_MAX_CELLS];  // lit segments per cell
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "shift_stats.h"
+#include <EEPROM.h>
+#include "crc8.h"
+#include "eeprom_ring.h"
+#include "weight_units.h"
+
+#if defined(__AVR__)
+#include <avr/eeprom.h>
+#define EEPROM_READY() eeprom_is_ready()
+#else
+#define EEPROM_READY() true
+#endif
+
+void LoadStats::clear() {
+  count = 0;
+  sum = 0;
+  min = 0;
+  max = 0;
+  m2 = 0;
+}
+
+// Welford's update: M2 grows by the product of the distances from the
+// old and the new mean. Both means come from the exact sum, so rounding
+// them doesn't accumulate.
+void LoadStats::add(int32_t grams) {
+  if (count == 0xFFFF) {
+    return;
+  }
+  if (count == 0 || grams < min) {
+    min = grams;
+  }
+  if (count == 0 || grams > max) {
+    max = grams;
+  }
+  int64_t before = grams - (int64_t) mean();
+  count++;
+  sum += grams;
+  int64_t after = grams - (int64_t) mean();
+  int64_t product = before * after + (1L << (LOAD_STATS_M2_SHIFT - 1));
+  m2 += product >> LOAD_STATS_M2_SHIFT;
+  if (m2 < 0) {
+    m2 = 0;
+  }
+}
+
+int32_t LoadStats::mean() const {
+  return count ? (int32_t) roundedDiv(sum, count) : 0;
+}
+
+// Bit by bit, one result bit per step: 32 shifts and compares
+static uint32_t isqrt(uint64_t n) {
+  uint64_t root = 0;
+  uint64_t bit = (uint64_t) 1 << 62;
+  while (bit > n) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (n >= root + bit) {
+      n -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t) root;
+}
+
+int32_t LoadStats::deviation() const {
+  if (count < 2) {
+    return 0;
+  }
+  uint64_t variance = (uint64_t) m2 / (count - 1);
+  if (variance > (~(uint64_t) 0 >> LOAD_STATS_M2_SHIFT)) {
+    return 0x7FFFFFFFL;
+  }
+  uint32_t root = isqrt(variance << LOAD_STATS_M2_SHIFT);
+  return root > 0x7FFFFFFFUL ? 0x7FFFFFFFL : (int32_t) root;
+}
+
+// Byte i of an aggregate's LOAD_STATS_SIZE byte record
+static uint8_t statsByte(const LoadStats &s, uint8_t i) {
+  if (i < 2) {
+    return s.count >> (8 * i);
+  }
+  if (i < 10) {
+    return (uint64_t) s.sum >> (8 * (i - 2));
+  }
+  if (i < 18) {
+    uint32_t v = i < 14 ? s.min : s.max;
+    return v >> (8 * ((i - 10) % 4));
+  }
+  return (uint64_t) s.m2 >> (8 * (i - 18));
+}
+
+static void readStats(LoadStats &s, const uint8_t *p) {
+  s.count = p[0] | (uint16_t) p[1] << 8;
+  s.sum = (int64_t) ((uint64_t) ringReadU32(p + 2) | (uint64_t) ringReadU32(p + 6) << 32);
+  s.min = (int32_t) ringReadU32(p + 10);
+  s.max = (int32_t) ringReadU32(p + 14);
+  s.m2 = (int64_t) ((uint64_t) ringReadU32(p + 18) | (uint64_t) ringReadU32(p + 22) << 32);
+}
+
+ShiftStats::ShiftStats(int baseAddress, uint32_t shiftSeconds, uint32_t dayStart)
+  : base(baseAddress), shiftLength(shiftSeconds), dayStart(dayStart), stamp(0), savedStamp(0),
+    copy(1), sequence(0), step(SHIFT_STATS_WRITE_STEPS) {
+  for (uint8_t i = 0; i < 2; i++) {
+    current[i].clear();
+    previous[i].clear();
+  }
+}
+
+bool ShiftStats::begin() {
+  uint8_t buf[SHIFT_STATS_BLOCK_SIZE];
+  bool found = false;
+
+  for (uint8_t c = 0; c < 2; c++) {
+    for (uint8_t i = 0; i < SHIFT_STATS_BLOCK_SIZE; i++) {
+      buf[i] = EEPROM.read(copyAddress(c) + i);
+    }
+    if (crc8(buf, SHIFT_STATS_BLOCK_SIZE - 1) != buf[SHIFT_STATS_BLOCK_SIZE - 1] ||
+        buf[4] != SHIFT_STATS_VERSION || ringReadU32(buf) <= sequence) {
+      continue;
+    }
+    sequence = ringReadU32(buf);
+    copy = c;
+    found = true;
+
+    stamp = ringReadU32(buf + 5);
+    readStats(current[0], buf + 9);
+    readStats(current[1], buf + 9 + LOAD_STATS_SIZE);
+  }
+  return found;
+}
+
+bool ShiftStats::tick(uint32_t now) {
+  bool rolled = false;
+  if (shiftNumber(now) != shiftNumber(stamp)) {
+    previous[0] = current[0];
+    current[0].clear();
+    rolled = true;
+  }
+  if (dayNumber(now) != dayNumber(stamp)) {
+    previous[1] = current[1];
+    current[1].clear();
+  }
+  if (busy() && rolled) {
+    save();  // restart a save in flight with the new aggregates
+  }
+  stamp = now;
+  return rolled;
+}
+
+void ShiftStats::add(int32_t grams, uint32_t now) {
+  tick(now);
+  if (busy()) {
+    save();
+  }
+  current[0].add(grams);
+  current[1].add(grams);
+}
+
+uint8_t ShiftStats::blockByte(uint8_t i) const {
+  if (i < 4) {
+    return (sequence + 1) >> (8 * i);
+  }
+  if (i == 4) {
+    return SHIFT_STATS_VERSION;
+  }
+  if (i < 9) {
+    return savedStamp >> (8 * (i - 5));
+  }
+  i -= 9;
+  return statsByte(current[i / LOAD_STATS_SIZE], i % LOAD_STATS_SIZE);
+}
+
+void ShiftStats::save() {
+  savedStamp = stamp;
+  step = 0;
+  crc = CRC8_INIT;
+}
+
+void ShiftStats::service() {
+  if (!busy() || !EEPROM_READY()) {
+    return;
+  }
+
+  // Step 0 invalidates the other copy before any of its bytes change; the
+  // CRC of the new one goes in last
+  uint8_t target = copy ^ 1;
+  int addr = copyAddress(target);
+  if (step == 0) {
+    EEPROM.update(addr + SHIFT_STATS_BLOCK_SIZE - 1, EEPROM.read(addr + SHIFT_STATS_BLOCK_SIZE - 1) ^ 0xFF);
+  } else if (step < SHIFT_STATS_BLOCK_SIZE) {
+    uint8_t b = blockByte(step - 1);
+    crc = crc8Update(crc, b);
+    EEPROM.update(addr + step - 1, b);
+  } else {
+    EEPROM.update(addr + SHIFT_STATS_BLOCK_SIZE - 1, crc);
+  }
+  step++;
+
+  if (!busy()) {
+    copy = target;
+    sequence++;
+  }
+}
@@ -0,0 +1,108 @@
+/**
+ * Per-shift and per-day load statistics, updated on every committed load.
+ *
+ * Each aggregate keeps the count, exact sum, min and max of the payloads,
+ * and the sum of squared differences from the mean (M2) by Welford's
+ * method: one update per load, numerically stable, and nothing to
+ * rescan. It is all integer math: the mean is the rounded sum / count,
+ * M2 is int64 in units of 2^LOAD_STATS_M2_SHIFT grams^2 (room for
+ * 65535 loads with a 190 t deviation; deviations under ~16 g read as 0)
+ * and the deviation is an integer square root. The load log can't answer
+ * "how much today" without walking EEPROM, and the Uno can't hold it.
+ *
+ * Time is a seconds clock kept by the sketch (there is no RTC). The
+ * aggregates belong to the shift and day that contain their timestamp;
+ * tick() starts new ones once the clock crosses into the next shift or
+ * day, keeping the one just closed as the previous shift (or day).
+ *
+ * Saved as A/B copies like the config block; the bytes are serialised
+ * straight from the aggregates as service() writes them, one per call
+ * with the CRC last, and a change while saving restarts the save.
+ *
+ * Block layout (SHIFT_STATS_BLOCK_SIZE bytes in a SHIFT_STATS_COPY_SIZE
+ * slot, little endian):
+ *   0  uint32 sequence
+ *   4  uint8  SHIFT_STATS_VERSION
+ *   5  uint32 clock (seconds) when the save was staged
+ *   9  shift aggregate, then day aggregate, LOAD_STATS_SIZE bytes each:
+ *        uint16 count, int64 sum, int32 min, int32 max (grams),
+ *        int64 M2 (2^LOAD_STATS_M2_SHIFT grams^2)
+ *   61 uint8  CRC-8 of bytes 0..60
+ */
+
+#ifndef SHIFT_STATS_H
+#define SHIFT_STATS_H
+
+#include <Arduino.h>
+
+#define SHIFT_STATS_VERSION 2
+#define LOAD_STATS_SIZE 26
+#define LOAD_STATS_M2_SHIFT 8
+#define SHIFT_STATS_BLOCK_SIZE (10 + 2 * LOAD_STATS_SIZE)
+#define SHIFT_STATS_COPY_SIZE 64
+#define SHIFT_STATS_WRITE_STEPS (SHIFT_STATS_BLOCK_SIZE + 1)
+
+struct LoadStats {
+  uint16_t count;
+  int64_t sum;     // grams
+  int32_t min;
+  int32_t max;
+  int64_t m2;      // sum of squared differences from the mean, >> LOAD_STATS_M2_SHIFT
+
+  void clear();
+  void add(int32_t grams);
+  int32_t mean() const;       // grams, rounded
+  int32_t deviation() const;  // standard deviation, grams
+};
+
+class ShiftStats {
+public:
+  // Shifts are shiftSeconds long (a whole fraction of a day), the first
+  // starting dayStart seconds after midnight; a day runs from one first
+  // shift to the next
+  ShiftStats(int baseAddress, uint32_t shiftSeconds, uint32_t dayStart);
+
+  // Restore the saved aggregates. Returns false if there are none; the
+  // clock they were saved at is the best guess of the time after a
+  // power loss.
+  bool begin();
+  uint32_t clock() const { return stamp; }
+
+  // Move to the shift and day that contain now, closing the current
+  // ones if they have ended. Returns true if anything rolled over.
+  bool tick(uint32_t now);
+
+  void add(int32_t grams, uint32_t now);
+
+  const LoadStats &shift() const { return current[0]; }
+  const LoadStats &day() const { return current[1]; }
+  const LoadStats &previousShift() const { return previous[0]; }
+  const LoadStats &previousDay() const { return previous[1]; }
+
+  // Stage the aggregates for saving; service() writes one byte per call
+  void save();
+  void service();
+  bool busy() const { return step < SHIFT_STATS_WRITE_STEPS; }
+
+private:
+  uint32_t shiftNumber(uint32_t t) const { return (t + 86400UL - dayStart) / shiftLength; }
+  uint32_t dayNumber(uint32_t t) const { return (t + 86400UL - dayStart) / 86400UL; }
+  int copyAddress(uint8_t copy) const { return base + copy * SHIFT_STATS_COPY_SIZE; }
+  uint8_t blockByte(uint8_t i) const;
+
+  int base;
+  uint32_t shiftLength;
+  uint32_t dayStart;
+
+  uint32_t stamp;           // clock the current aggregates belong to
+  uint32_t savedStamp;      // stamp when the save in flight was staged
+  LoadStats current[2];     // shift, day
+  LoadStats previous[2];    // since boot only, not saved
+
+  uint8_t copy;             // copy holding the saved aggregates
+  uint32_t sequence;
+  uint8_t step;             // next write step, SHIFT_STATS_WRITE_STEPS when idle
+  uint8_t crc;
+};
+
+#endif
@@ -0,0 +1,525 @@
+// Host benchmark: replays an HX711 trace through the unmodified sketch
+// (setup()/loop() from ../main.cpp) on the simulated board and reports
+// throughput, per-task cost, the loads the sketch detected and a model of
+// its supply current, awake and in idle mode.
+//
+//   bench [--realtime] [--quiet] [--check] [--eeprom <image>] [--sd <image>]
+//         [--serial <capture>] [--commands <requests>] <trace.csv>
+//
+// --realtime paces the replay to the simulated clock; by default it runs
+// as fast as the host allows. --eeprom boots from the EEPROM image in the
+// file (if it exists) and saves the EEPROM back to it afterwards, so two
+// runs in a row look like a power cycle. --sd does the same for the SD
+// card (a raw image of its blocks), which the sketch only uses when built
+// with BULK_LOG_ENABLED=1. --serial saves everything the sketch sent on
+// the UART (the telemetry stream) to a file; decode reads both back.
+// --commands feeds the bytes of a file (request frames, see request.cpp)
+// to the UART once the scale has been zeroed, as a host would send them.
+// --check compares each load the sketch committed with the outcome the
+// trace expects (trace.h): the number of loads, the payload error and the
+// detection latency in samples, and exits with status 1 if one is off
+// limits or a sample was dropped. make check runs it on every trace.
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "trace.h"
+#include "sim_hw.h"
+#include "sketch.h"
+#include "../weight_units.h"
+#include "../weight_filter.h"
+#include "../eeprom_layout.h"
+
+typedef std::chrono::steady_clock host_clock;
+
+// Simulated cost of one loop() pass outside the tasks (scheduler checks)
+#define SIM_LOOP_US 20
+
+// Simulated time spent after the trace ends so queued work can finish
+#define SIM_TAIL_US 2000000
+
+// Simulated SD card: 4 GB
+#define SIM_SD_BLOCKS 8388608UL
+
+#define MAX_TASKS 16
+
+// --check limits, unless the trace sets its own
+#define CHECK_PAYLOAD_ERROR_KG 20
+#define CHECK_LATENCY_SAMPLES  40  // 0.5 s at 80 SPS
+
+// Supply current model (mA), from the datasheets: ATmega328P at 16 MHz and
+// 5 V running and in power-down with the watchdog on, HX711 converting and
+// powered down, and the TFT backlight at full PWM. The Uno's regulator,
+// USB bridge and power LED add a constant ~30 mA that the sketch can't
+// change, so they're left out.
+#define SIM_MCU_ACTIVE_MA    9.0
+#define SIM_MCU_SLEEP_MA     0.006
+#define SIM_HX711_MA         1.5
+#define SIM_HX711_DOWN_MA    0.001
+#define SIM_BACKLIGHT_MA     80.0
+
+struct TaskStats {
+  unsigned long runs;
+  double hostNs;
+  uint64_t simUs;
+  uint64_t worstSimUs;
+};
+
+static TaskFunction task_fn[MAX_TASKS];
+static TaskStats task_stats[MAX_TASKS];
+
+// One trampoline per table slot, so each task's cost is measured
+// without touching the sketch
+template <int I> static void timedTask() {
+  host_clock::time_point t0 = host_clock::now();
+  uint64_t s0 = simMicros();
+  task_fn[I]();
+  uint64_t sim = simMicros() - s0;
+  TaskStats &st = task_stats[I];
+  st.runs++;
+  st.hostNs += std::chrono::duration<double, std::nano>(host_clock::now() - t0).count();
+  st.simUs += sim;
+  if (sim > st.worstSimUs) {
+    st.worstSimUs = sim;
+  }
+}
+
+static const TaskFunction trampolines[MAX_TASKS] = {
+  timedTask<0>, timedTask<1>, timedTask<2>, timedTask<3>,
+  timedTask<4>, timedTask<5>, timedTask<6>, timedTask<7>,
+  timedTask<8>, timedTask<9>, timedTask<10>, timedTask<11>,
+  timedTask<12>, timedTask<13>, timedTask<14>, timedTask<15>,
+};
+
+static void instrumentTasks() {
+  for (uint8_t i = 0; i < scheduler.taskCount() && i < MAX_TASKS; i++) {
+    task_fn[i] = tasks[i].run;
+    tasks[i].run = trampolines[i];
+  }
+}
+
+static bool loadEEPROM(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return false;
+  }
+  size_t n = fread(simEEPROM(), 1, SIM_EEPROM_SIZE, f);
+  fclose(f);
+  return n == SIM_EEPROM_SIZE;
+}
+
+static void saveEEPROM(const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (f) {
+    fwrite(simEEPROM(), 1, SIM_EEPROM_SIZE, f);
+    fclose(f);
+  }
+}
+
+static bool loadSD(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return false;
+  }
+  uint8_t block[SIM_SD_BLOCK_SIZE];
+  for (uint32_t b = 0; fread(block, 1, sizeof(block), f) == sizeof(block); b++) {
+    simSDWriteBlock(b, block);
+  }
+  fclose(f);
+  return true;
+}
+
+static void saveSD(const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    return;
+  }
+  uint8_t erased[SIM_SD_BLOCK_SIZE];
+  memset(erased, 0xFF, sizeof(erased));
+  for (uint32_t b = 0; b < simSDBlocksUsed(); b++) {
+    const uint8_t *block = simSDBlock(b);
+    fwrite(block ? block : erased, 1, SIM_SD_BLOCK_SIZE, f);
+  }
+  fclose(f);
+}
+
+static void saveSerial(const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    return;
+  }
+  uint8_t buf[256];
+  size_t n;
+  while ((n = simSerialTake(buf, sizeof(buf))) > 0) {
+    fwrite(buf, 1, n, f);
+  }
+  fclose(f);
+}
+
+static bool loadCommands(const char *path, std::vector<uint8_t> &bytes) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "bench: can't open %s\n", path);
+    return false;
+  }
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    bytes.push_back(c);
+  }
+  fclose(f);
+  return true;
+}
+
+static void presetCalibration(long countsPerKg) {
+  int32_t q = (int32_t) (countsPerKg * (1L << CAL_FACTOR_FRAC_BITS));
+  uint8_t *ee = simEEPROM();
+  for (int i = 0; i < 4; i++) {
+    ee[EEPROM_CAL_FACTOR_ADDR + i] = (uint32_t) q >> (8 * i);
+  }
+}
+
+// Host cost of the per-sample pipeline stages, outside the scheduler
+template <typename F> static double nsPerSample(const Trace &trace, F stage) {
+  const int passes = 20;
+  host_clock::time_point t0 = host_clock::now();
+  for (int p = 0; p < passes; p++) {
+    for (size_t i = 0; i < trace.samples.size(); i++) {
+      stage(trace.samples[i]);
+    }
+  }
+  double ns = std::chrono::duration<double, std::nano>(host_clock::now() - t0).count();
+  return ns / (passes * (double) trace.samples.size());
+}
+
+static volatile int32_t sink;
+
+// Time, sleep, HX711 power-down and backlight totals, split into idle mode
+// (any loop() pass that started or ended idle) and awake
+struct PowerTotals {
+  uint64_t us;
+  uint64_t sleptUs;
+  uint64_t downUs;
+  double backlightUs;  // us at full brightness
+};
+
+static void accumulate(PowerTotals &t, uint64_t us, uint64_t slept, uint64_t down, double backlight) {
+  t.us += us;
+  t.sleptUs += slept;
+  t.downUs += down;
+  t.backlightUs += backlight;
+}
+
+// A load as the sketch committed it, and how many samples the simulated
+// HX711 had produced by then
+struct CommittedLoad {
+  int64_t payload;  // grams
+  size_t sample;
+};
+
+// Prints one line per load and a verdict; false if something is off limits
+static bool checkLoads(const Trace &trace, const std::vector<CommittedLoad> &loads, unsigned dropped) {
+  if (!trace.has("expect_loads")) {
+    printf("check         skipped, the trace has no expect_loads\n");
+    return true;
+  }
+  long expected = trace.number("expect_loads");
+  bool payloadKnown = trace.has("expect_payload_kg");
+  int64_t payload = (int64_t) trace.number("expect_payload_kg") * 1000;
+  std::vector<long> unloaded = trace.numbers("expect_unloaded_at");
+  int64_t maxError = (int64_t) trace.number("max_payload_error_kg", CHECK_PAYLOAD_ERROR_KG) * 1000;
+  long maxLatency = trace.number("max_latency_samples", CHECK_LATENCY_SAMPLES);
+
+  std::string failures;
+  char buf[96];
+  int64_t worstError = 0;
+  long worstLatency = 0;
+  for (size_t i = 0; i < loads.size(); i++) {
+    printf("load %-8lu %9.1f kg", (unsigned long) i + 1, loads[i].payload / 1e3);
+    if (payloadKnown) {
+      int64_t error = loads[i].payload - payload;
+      int64_t size = error < 0 ? -error : error;
+      printf(", error %+.1f kg", error / 1e3);
+      worstError = size > worstError ? size : worstError;
+    }
+    if (i < unloaded.size()) {
+      long latency = (long) loads[i].sample - unloaded[i];
+      printf(", committed %ld samples after unloading", latency);
+      worstLatency = latency > worstLatency ? latency : worstLatency;
+    }
+    printf("\n");
+  }
+
+  if ((long) loads.size() != expected) {
+    snprintf(buf, sizeof(buf), "; %lu loads, expected %ld", (unsigned long) loads.size(), expected);
+    failures += buf;
+  }
+  if (worstError > maxError) {
+    snprintf(buf, sizeof(buf), "; payload error %.1f kg, limit %.1f", worstError / 1e3, maxError / 1e3);
+    failures += buf;
+  }
+  if (worstLatency > maxLatency) {
+    snprintf(buf, sizeof(buf), "; latency %ld samples, limit %ld", worstLatency, maxLatency);
+    failures += buf;
+  }
+  if (dropped) {
+    snprintf(buf, sizeof(buf), "; %u samples dropped", dropped);
+    failures += buf;
+  }
+  if (!failures.empty()) {
+    printf("check         FAILED: %s\n", failures.c_str() + 2);
+    return false;
+  }
+  printf("check         ok: %lu loads, payload error <= %.1f kg, latency <= %ld samples\n",
+         (unsigned long) loads.size(), worstError / 1e3, worstLatency);
+  return true;
+}
+
+static void printCurrent(const char *label, const PowerTotals &t) {
+  if (t.us == 0) {
+    return;
+  }
+  double mcu = (SIM_MCU_ACTIVE_MA * (t.us - t.sleptUs) + SIM_MCU_SLEEP_MA * t.sleptUs) / t.us;
+  double hx = (SIM_HX711_MA * (t.us - t.downUs) + SIM_HX711_DOWN_MA * t.downUs) / t.us;
+  double backlight = SIM_BACKLIGHT_MA * t.backlightUs / t.us;
+  printf("current       %-6s %6.2f mA (mcu %.2f, hx711 %.2f) + backlight %.1f mA\n", label, mcu + hx, mcu, hx,
+         backlight);
+}
+
+static void stageBenchmarks(const Trace &trace) {
+  long cal = trace.calFactor() ? trace.calFactor() : DEFAULT_CAL_FACTOR >> CAL_FACTOR_FRAC_BITS;
+  int64_t gain = gramsPerCount((int32_t) (cal * (1L << CAL_FACTOR_FRAC_BITS)));
+  int32_t offset = trace.samples.empty() ? 0 : trace.samples[0];
+
+  WeightFilter median, average;
+  median.configure(FILTER_MEDIAN, 5);
+  average.configure(FILTER_MOVING_AVERAGE, 8);
+  LoadDetectorConfig cfg = { 2000, 1000, 200, 40 };
+  LoadDetector det(cfg);
+  unsigned long t = 0;
+
+  printf("\nper-sample stages (host ns/sample)\n");
+  printf("  %-22s %8.1f\n", "median(5)", nsPerSample(trace, [&](int32_t s) { sink = median.update(s); }));
+  printf("  %-22s %8.1f\n", "moving average(8)", nsPerSample(trace, [&](int32_t s) { sink = average.update(s); }));
+  printf("  %-22s %8.1f\n", "counts to grams", nsPerSample(trace, [&](int32_t s) { sink = countsToGrams(s - offset, gain); }));
+  printf("  %-22s %8.1f\n", "load detector", nsPerSample(trace, [&](int32_t s) {
+    sink = det.update(countsToGrams(s - offset, gain), t += 12);
+  }));
+}
+
+int main(int argc, char **argv) {
+  bool realtime = false;
+  bool quiet = false;
+  bool check = false;
+  const char *path = 0;
+  const char *eeprom = 0;
+  const char *sd = 0;
+  const char *serial = 0;
+  const char *commands = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--realtime") == 0) {
+      realtime = true;
+    } else if (strcmp(argv[i], "--quiet") == 0) {
+      quiet = true;
+    } else if (strcmp(argv[i], "--check") == 0) {
+      check = true;
+    } else if (strcmp(argv[i], "--eeprom") == 0 && i + 1 < argc) {
+      eeprom = argv[++i];
+    } else if (strcmp(argv[i], "--sd") == 0 && i + 1 < argc) {
+      sd = argv[++i];
+    } else if (strcmp(argv[i], "--serial") == 0 && i + 1 < argc) {
+      serial = argv[++i];
+    } else if (strcmp(argv[i], "--commands") == 0 && i + 1 < argc) {
+      commands = argv[++i];
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "bench: unknown option %s\n", argv[i]);
+      return 2;
+    } else {
+      path = argv[i];
+    }
+  }
+  if (!path) {
+    fprintf(stderr, "usage: bench [--realtime] [--quiet] [--check] [--eeprom <image>] [--sd <image>]\n"
+                    "             [--serial <capture>] [--commands <requests>] <trace.csv>\n");
+    return 2;
+  }
+
+  Trace trace;
+  std::vector<uint8_t> requests;
+  if (!loadTrace(path, trace) || (commands && !loadCommands(commands, requests))) {
+    return 1;
+  }
+
+  simReset();
+  simHX711Attach(SKETCH_HX711_DT, SKETCH_HX711_SCK);
+  simSDAttach(SKETCH_SD_CS, SIM_SD_BLOCKS);
+  bool warm = eeprom && loadEEPROM(eeprom);
+  if (sd) {
+    loadSD(sd);
+  }
+  if (!warm && trace.calFactor()) {
+    presetCalibration(trace.calFactor());
+  }
+  uint32_t periodUs = 1000000 / trace.rate();
+  uint64_t feedStart = simMicros();
+  simHX711Feed(trace.samples.data(), trace.samples.size(), periodUs);
+
+  uint64_t bootStart = simMicros();
+  setup();
+  uint64_t setupUs = simMicros() - bootStart;
+  uint64_t firstWeightUs = 0;
+  instrumentTasks();
+
+  host_clock::time_point hostStart = host_clock::now();
+  uint64_t simStart = simMicros();
+  uint64_t tailUntil = 0;
+  unsigned long passes = 0;
+
+  // Wake latency: from the first trace sample that is wakeBand off the
+  // weight at idle entry (the load arriving) to the sketch waking up
+  long cal = trace.calFactor() ? trace.calFactor() : DEFAULT_CAL_FACTOR >> CAL_FACTOR_FRAC_BITS;
+  int64_t wakeCounts = (int64_t) power.config().wakeBand * (cal < 0 ? -cal : cal) / 1000;
+  PowerTotals awake = { 0, 0, 0, 0 };
+  PowerTotals idle = { 0, 0, 0, 0 };
+  unsigned idlePeriods = 0;
+  unsigned loadWakes = 0;
+  uint64_t worstWakeUs = 0;
+  uint64_t totalWakeUs = 0;
+  size_t idleFrom = 0;  // trace index at idle entry
+  std::vector<CommittedLoad> committed;
+  int loadsSeen = 0;
+  int64_t totalSeen = 0;
+
+  for (;;) {
+    bool wasIdle = power.idle();
+    uint64_t t0 = simMicros();
+    uint64_t slept0 = simSleptMicros();
+    uint64_t down0 = simHX711DownMicros();
+#if BACKLIGHT_ENABLED
+    int brightness = simAnalogLevel(SKETCH_BACKLIGHT_PIN);
+#else
+    int brightness = 255;
+#endif
+    loop();
+    simAdvance(SIM_LOOP_US);
+    passes++;
+
+    bool isIdle = power.idle();
+    uint64_t dt = simMicros() - t0;
+    accumulate(wasIdle || isIdle ? idle : awake, dt, simSleptMicros() - slept0, simHX711DownMicros() - down0,
+               dt * brightness / 255.0);
+    if (!wasIdle && isIdle) {
+      idlePeriods++;
+      idleFrom = (t0 - feedStart) / periodUs;
+    } else if (wasIdle && !isIdle) {
+      for (size_t k = idleFrom; k < trace.samples.size(); k++) {
+        int64_t off = (int64_t) trace.samples[k] - trace.samples[idleFrom];
+        uint64_t at = feedStart + (uint64_t) (k + 1) * periodUs;
+        if (at > simMicros()) {
+          break;
+        }
+        if (off >= wakeCounts || -off >= wakeCounts) {
+          uint64_t latency = simMicros() - at;
+          loadWakes++;
+          totalWakeUs += latency;
+          worstWakeUs = latency > worstWakeUs ? latency : worstWakeUs;
+          break;
+        }
+      }
+    }
+
+    if (load_count != loadsSeen) {
+      // A reset over serial clears the totals; only an increase is a load
+      if (load_count > loadsSeen) {
+        CommittedLoad load = { total_weight - totalSeen, simHX711Produced() };
+        committed.push_back(load);
+      }
+      loadsSeen = load_count;
+      totalSeen = total_weight;
+    }
+
+    if (firstWeightUs == 0 && scale_zeroed) {
+      firstWeightUs = simMicros() - bootStart;
+      simSerialInject(requests.data(), requests.size());
+    }
+
+    if (realtime) {
+      std::this_thread::sleep_until(hostStart + std::chrono::microseconds(simMicros() - simStart));
+    }
+    if (tailUntil == 0 && simHX711Exhausted() && !sampler.available()) {
+      tailUntil = simMicros() + SIM_TAIL_US;
+    }
+    if (tailUntil != 0 && simMicros() >= tailUntil) {
+      break;
+    }
+  }
+
+  double hostS = std::chrono::duration<double>(host_clock::now() - hostStart).count();
+  double simS = (simMicros() - simStart) / 1e6;
+  size_t produced = simHX711Produced();
+
+  printf("trace         %s\n", trace.path.c_str());
+  printf("samples       %lu at %u SPS (%.1f s simulated)\n", (unsigned long) produced, trace.rate(), simS);
+  printf("replay        %.3f s host, %.0f samples/s, %.1fx real time\n", hostS, produced / hostS, simS / hostS);
+  printf("boot          %s, setup %.1f ms, first weight at %.1f ms\n", warm ? "warm" : "cold",
+         setupUs / 1e3, firstWeightUs / 1e3);
+  printf("loop passes   %lu\n", passes);
+  printf("dropped       %u samples, %u telemetry packets\n", sampler.droppedSamples(), telemetry.droppedPackets());
+  printf("tft           %lu pixels written\n", simPixelsWritten());
+  printf("serial        %lu bytes sent\n", simSerialBytesSent());
+  printf("loads         %d, total %.3f t\n", load_count, total_weight / 1e6);
+  printf("idle          %u periods, %.1f s (%.0f%% of the run)", idlePeriods, idle.us / 1e6,
+         100.0 * idle.us / (idle.us + awake.us));
+  if (loadWakes) {
+    printf(", %u woken by a load: worst %.0f ms, mean %.0f ms", loadWakes, worstWakeUs / 1e3,
+           totalWakeUs / 1e3 / loadWakes);
+  }
+  printf("\n");
+  printCurrent("awake", awake);
+  printCurrent("idle", idle);
+#if BULK_LOG_ENABLED
+  static const char *const bulk_states[] = { "off", "starting", "recovering", "idle", "sending", "programming" };
+  printf("sd log        %s, next block %lu, %lu blocks written, %lu read, %u records dropped\n",
+         bulk_states[bulkLog.state()], (unsigned long) bulkLog.nextSequence(), simSDBlocksWritten(),
+         simSDBlocksRead(), bulkLog.droppedRecords());
+#endif
+
+  if (!quiet) {
+    printf("\n%-10s %8s %12s %12s %12s %8s\n", "task", "runs", "host ns/run", "sim us/run", "sim worst us", "overruns");
+    for (uint8_t i = 0; i < scheduler.taskCount() && i < MAX_TASKS; i++) {
+      const TaskStats &st = task_stats[i];
+      const Task &t = scheduler.task(i);
+      printf("%-10s %8lu %12.0f %12.1f %12llu %8u\n", t.name, st.runs,
+             st.runs ? st.hostNs / st.runs : 0.0,
+             st.runs ? (double) st.simUs / st.runs : 0.0,
+             (unsigned long long) st.worstSimUs, t.overruns);
+    }
+#if PROFILER_ENABLED
+    // The sketch restarts each window when it dumps it, so this is the
+    // last (partial) window; overruns count from boot
+    printf("\n%-10s %8s %8s %8s %8s %8s\n", "profile", "count", "min us", "avg us", "max us", "overruns");
+    for (uint8_t i = 0; i < profiler.sectionCount(); i++) {
+      ProfileReport r;
+      profiler.report(i, r);
+      printf("%-10s %8lu %8u %8u %8u %8u\n", profiler.section(i).name,
+             (unsigned long) r.count, r.min, r.avg, r.max, r.overruns);
+    }
+#endif
+    stageBenchmarks(trace);
+  }
+  bool passed = true;
+  if (check) {
+    printf("\n");
+    passed = checkLoads(trace, committed, sampler.droppedSamples());
+  }
+  if (eeprom) {
+    saveEEPROM(eeprom);
+  }
+  if (sd) {
+    saveSD(sd);
+  }
+  if (serial) {
+    saveSerial(serial);
+  }
+  return passed ? 0 : 1;
+}
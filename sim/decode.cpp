@@ -0,0 +1,302 @@
+// Host decoder for the sketch's compressed sample history.
+//
+//   decode sd <image> [--trace] [--rate <sps>]
+//   decode serial <capture> [--trace] [--history <image>]
+//
+// "sd" reads a raw image of the SD card written with BULK_LOG_ENABLED=1
+// (bulk_log.h): every intact block, in sequence order. "serial" reads a
+// capture of the telemetry stream (telemetry.h), resynchronising on bad
+// frames. Records are printed as CSV:
+//
+//   sample,<time ms>,<raw>[,<grams>]
+//   load,<time ms>,<payload g>,<peak g>,<duration s>
+//
+// SD runs only carry the time of their first sample; the others are
+// placed at --rate (80 by default). Serial samples have no time. With
+// --trace only the raw counts are printed, as a trace bench can replay. A
+// summary with the bytes per sample goes to stderr.
+//
+// Replies to host requests (command_parser.h) in a serial capture are
+// printed as reply,<request>,<status>[,<fields>...]. History blocks
+// downloaded with CMD_READ_HISTORY are written to the --history image,
+// which "decode sd" then reads like the card itself.
+
+#include <map>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../bulk_log.h"
+#include "../telemetry.h"
+#include "../command_parser.h"
+#include "../load_log.h"
+#include "../crc8.h"
+#include "../sample_codec.h"
+
+struct Summary {
+  unsigned long samples;
+  unsigned long loads;
+  unsigned long bytes;      // card blocks / sample frames
+  unsigned long skipped;    // bad blocks / frames
+};
+
+static bool trace_only = false;
+static double rate = 80;
+static Summary summary;
+
+// History blocks downloaded over serial, by sequence
+static std::map<uint32_t, std::vector<uint8_t> > history;
+
+static uint32_t getU32(const uint8_t *p) {
+  return p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static uint16_t getU16(const uint8_t *p) {
+  return p[0] | (uint16_t) p[1] << 8;
+}
+
+static void sample(double timeMs, int32_t raw, bool hasGrams, int32_t grams) {
+  summary.samples++;
+  if (trace_only) {
+    printf("%d\n", raw);
+  } else if (timeMs < 0) {
+    printf("sample,,%d,%d\n", raw, grams);
+  } else if (hasGrams) {
+    printf("sample,%.0f,%d,%d\n", timeMs, raw, grams);
+  } else {
+    printf("sample,%.0f,%d\n", timeMs, raw);
+  }
+}
+
+static void load(double timeMs, int32_t payload, int32_t peak, uint16_t duration) {
+  summary.loads++;
+  if (trace_only) {
+    return;
+  }
+  if (timeMs < 0) {
+    printf("load,,%d,%d,%u\n", payload, peak, duration);
+  } else {
+    printf("load,%.0f,%d,%d,%u\n", timeMs, payload, peak, duration);
+  }
+}
+
+static bool crcOk(const uint8_t *block) {
+  uint8_t crc = CRC8_INIT;
+  for (int i = 0; i < SD_BLOCK_SIZE - 1; i++) {
+    crc = crc8Update(crc, block[i]);
+  }
+  return crc == block[SD_BLOCK_SIZE - 1];
+}
+
+static void decodeBlock(const uint8_t *b) {
+  uint32_t base = getU32(b + 8);
+  uint16_t pos = BULK_HEADER_SIZE;
+  for (uint8_t r = 0; r < b[3] && pos + BULK_RECORD_HEADER <= SD_BLOCK_SIZE - 1; r++) {
+    uint8_t type = b[pos];
+    uint8_t len = b[pos + 1];
+    double t = base + getU16(b + pos + 2);
+    const uint8_t *d = b + pos + BULK_RECORD_HEADER;
+    if (pos + BULK_RECORD_HEADER + len > SD_BLOCK_SIZE - 1) {
+      break;
+    }
+    if (type == BULK_SAMPLES && len >= 4) {
+      int32_t value = (int32_t) getU32(d);
+      sample(t, value, false, 0);
+      for (uint16_t i = 4, k = 1; i < len; k++) {
+        uint32_t z;
+        uint8_t n = getVarint(d + i, len - i, z);
+        if (n == 0) {
+          break;
+        }
+        i += n;
+        value += zigzagDecode(z);
+        sample(t + k * 1000.0 / rate, value, false, 0);
+      }
+    } else if (type == BULK_LOAD && len >= 10) {
+      load(t, (int32_t) getU32(d), (int32_t) getU32(d + 4), getU16(d + 8));
+    }
+    pos += BULK_RECORD_HEADER + len;
+  }
+  summary.bytes += SD_BLOCK_SIZE;
+}
+
+static int decodeSD(FILE *f) {
+  std::map<uint32_t, std::vector<uint8_t> > blocks;
+  std::vector<uint8_t> b(SD_BLOCK_SIZE);
+  while (fread(b.data(), 1, SD_BLOCK_SIZE, f) == SD_BLOCK_SIZE) {
+    if (getU16(b.data()) != BULK_BLOCK_MAGIC || b[2] != BULK_LOG_VERSION) {
+      continue;  // index, erased or foreign
+    }
+    if (!crcOk(b.data())) {
+      summary.skipped++;
+      continue;
+    }
+    blocks[getU32(b.data() + 4)] = b;
+  }
+  for (std::map<uint32_t, std::vector<uint8_t> >::const_iterator it = blocks.begin(); it != blocks.end(); ++it) {
+    decodeBlock(it->second.data());
+  }
+  return 0;
+}
+
+static void reply(uint8_t request, const uint8_t *p, uint8_t len) {
+  static const char *const requests[] = {
+    "status", "totals", "stats", "calibrate", "target", "clock", "tare", "reset", "loads", "history"
+  };
+  static const char *const statuses[] = { "ok", "end", "busy", "bad", "unavailable" };
+  if (len < 1 || request < CMD_STATUS || request > CMD_READ_HISTORY || p[0] > COMMAND_UNAVAILABLE) {
+    return;
+  }
+  if (request == CMD_READ_HISTORY && p[0] == COMMAND_OK && len == 7 + COMMAND_CHUNK) {
+    std::vector<uint8_t> &b = history[getU32(p + 1)];
+    uint16_t offset = getU16(p + 5);
+    b.resize(SD_BLOCK_SIZE);
+    if (offset + COMMAND_CHUNK <= SD_BLOCK_SIZE) {
+      memcpy(&b[offset], p + 7, COMMAND_CHUNK);
+    }
+    return;
+  }
+  if (trace_only) {
+    return;
+  }
+  uint8_t status = p[0];
+  printf("reply,%s,%s", requests[request - CMD_STATUS], statuses[status]);
+  p++;
+  len--;
+  if (status == COMMAND_OK) {
+    if (request == CMD_STATUS && len >= 22) {
+      printf(",%u,%d,0x%02x,%u,%u,%u,%u,%u", getU32(p), (int32_t) getU32(p + 4), p[8], getU32(p + 9),
+             getU16(p + 13), getU16(p + 15), p[17], getU32(p + 18));
+      if (len >= 24) {
+        printf(",0x%02x,0x%02x", p[22], p[23]);
+      }
+    } else if (request == CMD_TOTALS && len >= 10) {
+      printf(",%u,%lld", getU16(p), (long long) (getU32(p + 2) | (uint64_t) getU32(p + 6) << 32));
+    } else if (request == CMD_STATS && len >= TELEMETRY_STATS_SIZE) {
+      printf(",%u,%u,%lld,%d,%d,%d,%d", p[0], getU16(p + 1),
+             (long long) (getU32(p + 3) | (uint64_t) getU32(p + 7) << 32), (int32_t) getU32(p + 11),
+             (int32_t) getU32(p + 15), (int32_t) getU32(p + 19), (int32_t) getU32(p + 23));
+    } else if (request == CMD_READ_LOADS && len >= 14) {
+      printf(",%u,%u,%d,%u", getU32(p), getU32(p + 4), (int32_t) getU32(p + 8), getU16(p + 12));
+      if (len >= 15) {
+        printf(",%s", p[14] == LOAD_LOG_PAYLOAD ? "payload" : "peak");
+      }
+    }
+  }
+  printf("\n");
+}
+
+static void saveHistory(const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    fprintf(stderr, "decode: can't write %s\n", path);
+    return;
+  }
+  for (std::map<uint32_t, std::vector<uint8_t> >::const_iterator it = history.begin(); it != history.end(); ++it) {
+    fwrite(it->second.data(), 1, SD_BLOCK_SIZE, f);
+  }
+  fclose(f);
+  fprintf(stderr, "%lu history blocks written to %s\n", (unsigned long) history.size(), path);
+}
+
+static void decodeFrame(uint8_t type, const uint8_t *p, uint8_t len) {
+  if (type == TELEMETRY_SAMPLES && len >= 9) {
+    int32_t raw = (int32_t) getU32(p + 1);
+    int32_t grams = (int32_t) getU32(p + 5);
+    sample(-1, raw, true, grams);
+    uint8_t i = 9;
+    for (uint8_t k = 1; k < p[0]; k++) {
+      uint32_t zr, zg;
+      uint8_t n = getVarint(p + i, len - i, zr);
+      uint8_t m = n ? getVarint(p + i + n, len - i - n, zg) : 0;
+      if (m == 0) {
+        break;
+      }
+      i += n + m;
+      raw += zigzagDecode(zr);
+      grams += zigzagDecode(zg);
+      sample(-1, raw, true, grams);
+    }
+    summary.bytes += len + 4;  // sync, length, type, CRC
+  } else if (type == TELEMETRY_LOAD && len >= 14) {
+    load(getU32(p), (int32_t) getU32(p + 4), (int32_t) getU32(p + 8), getU16(p + 12));
+  } else if (type & COMMAND_REPLY) {
+    reply(type & ~COMMAND_REPLY, p, len);
+  }
+}
+
+static int decodeSerial(FILE *f) {
+  std::vector<uint8_t> s;
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    s.push_back(c);
+  }
+  size_t i = 0;
+  while (i + 4 <= s.size()) {
+    uint8_t frameLen = s[i + 1];
+    if (s[i] != TELEMETRY_SYNC || frameLen == 0 || i + 3 + frameLen > s.size()) {
+      i++;
+      continue;
+    }
+    uint8_t crc = CRC8_INIT;
+    for (uint8_t k = 0; k <= frameLen; k++) {
+      crc = crc8Update(crc, s[i + 1 + k]);
+    }
+    if (crc != s[i + 2 + frameLen]) {
+      summary.skipped++;
+      i++;
+      continue;
+    }
+    decodeFrame(s[i + 2], &s[i + 3], frameLen - 1);
+    i += 3 + frameLen;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  const char *kind = 0;
+  const char *path = 0;
+  const char *historyPath = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--trace") == 0) {
+      trace_only = true;
+    } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+      rate = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+      historyPath = argv[++i];
+    } else if (!kind) {
+      kind = argv[i];
+    } else {
+      path = argv[i];
+    }
+  }
+  bool sd = kind && strcmp(kind, "sd") == 0;
+  if (!path || (!sd && strcmp(kind, "serial") != 0) || rate <= 0) {
+    fprintf(stderr, "usage: decode sd <image> [--trace] [--rate <sps>]\n"
+                    "       decode serial <capture> [--trace] [--history <image>]\n");
+    return 2;
+  }
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "decode: can't open %s\n", path);
+    return 1;
+  }
+  if (trace_only) {
+    printf("# source: %s\n# rate: %.0f\n", path, rate);
+  }
+  int rc = sd ? decodeSD(f) : decodeSerial(f);
+  fclose(f);
+  if (historyPath) {
+    saveHistory(historyPath);
+  }
+
+  // Against 8 bytes a sample uncoded on the card, a 12-byte frame each on
+  // the serial link
+  double plain = sd ? 8 : 12;
+  double per = summary.samples ? (double) summary.bytes / summary.samples : 0;
+  fprintf(stderr, "%lu samples, %lu loads, %lu bad %s; %.2f bytes per sample (%.1fx smaller)\n",
+          summary.samples, summary.loads, summary.skipped, sd ? "blocks" : "frames", per,
+          per > 0 ? plain / per : 0);
+  return rc;
+}
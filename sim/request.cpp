@@ -0,0 +1,103 @@
+// Host encoder for the sketch's serial requests (command_parser.h): writes
+// one request frame per command to stdout, for bench --commands or a real
+// port. decode serial prints the replies.
+//
+//   request <command> [<command> ...] > requests.bin
+//
+//   status | totals | stats <shift|day|lastshift|lastday>
+//   calibrate <counts per kg> | target <kg> <overload %> | clock <s>
+//   tare | reset | loads <first> <count> | history <first> <count>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../command_parser.h"
+#include "../telemetry.h"
+#include "../weight_units.h"
+#include "../crc8.h"
+
+static void putU32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = v >> (8 * i);
+  }
+}
+
+static void frame(uint8_t type, const uint8_t *payload, uint8_t len) {
+  uint8_t crc = crc8Update(crc8Update(CRC8_INIT, len + 1), type);
+  putchar(TELEMETRY_SYNC);
+  putchar(len + 1);
+  putchar(type);
+  for (uint8_t i = 0; i < len; i++) {
+    putchar(payload[i]);
+    crc = crc8Update(crc, payload[i]);
+  }
+  putchar(crc);
+}
+
+static int usage() {
+  fprintf(stderr, "usage: request <command> [<command> ...]\n"
+                  "  status | totals | stats <shift|day|lastshift|lastday>\n"
+                  "  calibrate <counts per kg> | target <kg> <overload %%> | clock <s>\n"
+                  "  tare | reset | loads <first> <count> | history <first> <count>\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  static const char *const kinds[] = { "shift", "day", "lastshift", "lastday" };
+  if (argc < 2) {
+    return usage();
+  }
+  for (int i = 1; i < argc; i++) {
+    const char *c = argv[i];
+    int args = argc - i - 1;
+    uint8_t p[COMMAND_MAX_PAYLOAD];
+    if (strcmp(c, "status") == 0) {
+      frame(CMD_STATUS, p, 0);
+    } else if (strcmp(c, "totals") == 0) {
+      frame(CMD_TOTALS, p, 0);
+    } else if (strcmp(c, "tare") == 0) {
+      frame(CMD_TARE, p, 0);
+    } else if (strcmp(c, "reset") == 0) {
+      frame(CMD_RESET, p, 0);
+    } else if (strcmp(c, "stats") == 0 && args >= 1) {
+      p[0] = 0xFF;
+      for (uint8_t k = 0; k < 4; k++) {
+        if (strcmp(argv[i + 1], kinds[k]) == 0) {
+          p[0] = k;
+        }
+      }
+      if (p[0] == 0xFF) {
+        return usage();
+      }
+      frame(CMD_STATS, p, 1);
+      i++;
+    } else if (strcmp(c, "calibrate") == 0 && args >= 1) {
+      putU32(p, (uint32_t) (int32_t) (atof(argv[++i]) * (1L << CAL_FACTOR_FRAC_BITS)));
+      frame(CMD_SET_CALIBRATION, p, 4);
+    } else if (strcmp(c, "target") == 0 && args >= 2) {
+      putU32(p, (uint32_t) (int32_t) (atof(argv[i + 1]) * 1000));
+      p[4] = atoi(argv[i + 2]);
+      frame(CMD_SET_TARGET, p, 5);
+      i += 2;
+    } else if (strcmp(c, "clock") == 0 && args >= 1) {
+      putU32(p, strtoul(argv[++i], 0, 0));
+      frame(CMD_SET_CLOCK, p, 4);
+    } else if (strcmp(c, "loads") == 0 && args >= 2) {
+      putU32(p, strtoul(argv[i + 1], 0, 0));
+      p[4] = atoi(argv[i + 2]);
+      frame(CMD_READ_LOADS, p, 5);
+      i += 2;
+    } else if (strcmp(c, "history") == 0 && args >= 2) {
+      putU32(p, strtoul(argv[i + 1], 0, 0));
+      unsigned long count = strtoul(argv[i + 2], 0, 0);
+      p[4] = count & 0xFF;
+      p[5] = count >> 8;
+      frame(CMD_READ_HISTORY, p, 6);
+      i += 2;
+    } else {
+      return usage();
+    }
+  }
+  return 0;
+}
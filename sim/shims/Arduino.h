@@ -0,0 +1,124 @@
+/**
+ * Host stand-in for the Arduino core, just enough of it for the sketch.
+ *
+ * Time, pins and interrupts are simulated by sim_hw.cpp; see sim_hw.h for
+ * the harness side of the model.
+ */
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define NUM_DIGITAL_PINS 20
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *) (p))
+#define pgm_read_word(p) (*(const uint16_t *) (p))
+#define pgm_read_dword(p) (*(const uint32_t *) (p))
+#define pgm_read_ptr(p) (*(void * const *) (p))
+#define memcpy_P memcpy
+
+#define bit(b) (1UL << (b))
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : NOT_AN_INTERRUPT))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+void attachInterrupt(uint8_t irq, void (*isr)(), int mode);
+void detachInterrupt(uint8_t irq);
+void noInterrupts();
+void interrupts();
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+class String {
+public:
+  String(const char *s = "") : s_(s) {}
+  String &operator+=(char c) { s_ += c; return *this; }
+  bool operator==(const char *o) const { return s_ == o; }
+  unsigned int length() const { return s_.size(); }
+  int indexOf(char c) const { size_t p = s_.find(c); return p == std::string::npos ? -1 : (int) p; }
+  float toFloat() const { return atof(s_.c_str()); }
+  const char *c_str() const { return s_.c_str(); }
+private:
+  std::string s_;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  size_t write(const char *s) { size_t n = 0; while (*s) n += write((uint8_t) *s++); return n; }
+  size_t write(const uint8_t *b, size_t len) { for (size_t i = 0; i < len; i++) write(b[i]); return len; }
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t) c); }
+  size_t print(int v) { return print((long) v); }
+  size_t print(unsigned int v) { return print((unsigned long) v); }
+  size_t print(long v) { char b[24]; snprintf(b, sizeof b, "%ld", v); return write(b); }
+  size_t print(unsigned long v) { char b[24]; snprintf(b, sizeof b, "%lu", v); return write(b); }
+  size_t print(double v, int digits = 2) { char b[40]; snprintf(b, sizeof b, "%.*f", digits, v); return write(b); }
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+};
+
+// UART with the core's 64-byte TX buffer, drained at the configured baud
+// rate in simulated time. write() blocks (advancing time) when it is full,
+// like the real one.
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud);
+  void end() {}
+  int available();
+  int read();
+  int peek();
+  int availableForWrite();
+  size_t write(uint8_t c);
+  using Print::write;
+  void flush();
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#ifndef abs
+#define abs(x) ((x) > 0 ? (x) : -(x))
+#endif
+
+#endif
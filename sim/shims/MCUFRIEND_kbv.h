@@ -0,0 +1,28 @@
+/**
+ * Host stand-in for MCUFRIEND_kbv: a 240x320 RGB565 panel rendered into the
+ * simulated framebuffer, charging simulated bus time per pixel.
+ */
+
+#ifndef SIM_MCUFRIEND_KBV_H
+#define SIM_MCUFRIEND_KBV_H
+
+#include <Adafruit_GFX.h>
+
+class MCUFRIEND_kbv : public Adafruit_GFX {
+public:
+  MCUFRIEND_kbv(int cs = 0, int cd = 0, int wr = 0, int rd = 0, int rst = 0);
+  uint16_t readID();
+  void begin(uint16_t id = 0x9341);
+  void drawPixel(int16_t x, int16_t y, uint16_t color);
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void setAddrWindow(int16_t x, int16_t y, int16_t x1, int16_t y1);
+  void pushColors(uint16_t *block, int16_t n, bool first);
+  void pushColors(const uint8_t *block, int16_t n, bool first, bool bigend = false);
+  void vertScroll(int16_t top, int16_t scrollines, int16_t offset);
+  uint16_t readPixel(int16_t x, int16_t y);
+
+private:
+  int16_t winX0, winY0, winX1, winY1, winX, winY;
+};
+
+#endif
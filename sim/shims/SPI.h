@@ -0,0 +1,36 @@
+/**
+ * Host stand-in for the Arduino SPI library. Bytes go to the simulated SD
+ * card (see simSDAttach() in sim_hw.h); each one costs eight clocks at the
+ * transaction's speed plus the AVR's per-byte overhead.
+ */
+
+#ifndef SIM_SPI_H
+#define SIM_SPI_H
+
+#include <Arduino.h>
+
+#define MSBFIRST 1
+#define SPI_MODE0 0
+
+class SPISettings {
+public:
+  SPISettings(uint32_t clock = 4000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0)
+    : clock(clock) {
+    (void) bitOrder;
+    (void) dataMode;
+  }
+  uint32_t clock;
+};
+
+class SPIClass {
+public:
+  void begin() {}
+  void end() {}
+  void beginTransaction(SPISettings settings);
+  void endTransaction() {}
+  uint8_t transfer(uint8_t data);
+};
+
+extern SPIClass SPI;
+
+#endif
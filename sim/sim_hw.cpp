@@ -0,0 +1,915 @@
+// Device models behind the host shims; see sim_hw.h.
+
+#include <deque>
+#include <map>
+#include <vector>
+#include "sim_hw.h"
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include <MCUFRIEND_kbv.h>
+#include <TouchScreen.h>
+#include <EEPROM.h>
+#include <SPI.h>
+#include "power_manager.h"
+
+// ---------------------------------------------------------------- clock
+
+static uint64_t now_ns = 0;
+
+// ---------------------------------------------------------------- pins & interrupts
+
+static uint8_t pin_level[NUM_DIGITAL_PINS];
+static int analog_level[NUM_DIGITAL_PINS];
+static void (*isr_handler[2])() = { 0, 0 };
+static int isr_mode[2];
+static bool isr_pending[2];
+static bool interrupts_enabled = true;
+static bool in_isr = false;
+
+static void dispatchInterrupts() {
+  if (in_isr || !interrupts_enabled) {
+    return;
+  }
+  for (int irq = 0; irq < 2; irq++) {
+    if (isr_pending[irq] && isr_handler[irq]) {
+      isr_pending[irq] = false;
+      // Like the AVR: interrupts are off while the handler runs
+      in_isr = true;
+      interrupts_enabled = false;
+      isr_handler[irq]();
+      interrupts_enabled = true;
+      in_isr = false;
+    }
+  }
+}
+
+static void raiseEdge(uint8_t pin, bool falling) {
+  int irq = digitalPinToInterrupt(pin);
+  if (irq < 0 || !isr_handler[irq]) {
+    return;
+  }
+  int mode = isr_mode[irq];
+  if (mode == CHANGE || (falling && mode == FALLING) || (!falling && mode == RISING)) {
+    isr_pending[irq] = true;
+    dispatchInterrupts();
+  }
+}
+
+// ---------------------------------------------------------------- HX711
+
+// Each chip has its own DOUT and conversion clock; all of them listen to
+// the one SCK line, as when several HX711s share it.
+struct SimHX711 {
+  uint8_t dout = 0xFF;
+  std::vector<int32_t> samples;
+  size_t next = 0;
+  uint32_t period_us = 12500;
+  uint64_t next_conversion_ns = 0;
+  int32_t latched = 0;
+  bool ready = false;     // conversion waiting to be clocked out
+  uint8_t pulses = 0;     // SCK rising edges since it became ready
+  bool powered_down = false;
+  uint64_t settled_ns = 0;  // conversions before this are lost (waking up)
+};
+
+static SimHX711 chips[SIM_HX711_MAX_CHIPS];
+static uint8_t chip_count = 0;
+static uint8_t hx_sck = 0xFF;
+static bool sck_high = false;
+static uint64_t sck_high_since_ns = 0;
+static uint64_t hx_down_ns = 0;
+
+static void setDout(SimHX711 &hx, bool level) {
+  bool was = pin_level[hx.dout];
+  pin_level[hx.dout] = level;
+  if (was && !level) {
+    raiseEdge(hx.dout, true);
+  }
+}
+
+static void hxConversion(SimHX711 &hx) {
+  if (hx.next >= hx.samples.size()) {
+    return;
+  }
+  // The trace keeps time while the chip is powered down or settling, but
+  // those conversions never happen
+  int32_t sample = hx.samples[hx.next++];
+  if (hx.powered_down || now_ns < hx.settled_ns) {
+    return;
+  }
+  if (hx.ready && hx.pulses > 0) {
+    return;  // being clocked out; this conversion is lost
+  }
+  // An unread conversion is simply replaced and DOUT stays low
+  hx.latched = sample & 0xFFFFFF;
+  hx.ready = true;
+  setDout(hx, LOW);
+}
+
+static void hxSckEdge(SimHX711 &hx, bool high) {
+  if (high) {
+    if (!hx.ready) {
+      return;
+    }
+    hx.pulses++;
+    if (hx.pulses <= 24) {
+      setDout(hx, (hx.latched >> (24 - hx.pulses)) & 1);
+    } else {
+      // 25th pulse: end of data, DOUT high until the next conversion
+      hx.ready = false;
+      hx.pulses = 0;
+      pin_level[hx.dout] = HIGH;
+    }
+  } else if (now_ns - sck_high_since_ns >= 60000) {
+    // Leaving power-down: the chip resets and settles before converting
+    hx.powered_down = false;
+    hx.ready = false;
+    hx.pulses = 0;
+    pin_level[hx.dout] = HIGH;
+    hx.settled_ns = now_ns + (uint64_t) SIM_HX711_WAKE_US * 1000;
+  }
+}
+
+static void hxSck(bool high) {
+  if (high == sck_high) {
+    return;
+  }
+  sck_high = high;
+  if (high) {
+    sck_high_since_ns = now_ns;
+  } else if (now_ns - sck_high_since_ns >= 60000) {
+    hx_down_ns += now_ns - sck_high_since_ns - 60000;
+  }
+  for (uint8_t i = 0; i < chip_count; i++) {
+    hxSckEdge(chips[i], high);
+  }
+}
+
+static void hxAdvanceTo(uint64_t target_ns) {
+  for (;;) {
+    // Next conversion of any chip, in time order
+    SimHX711 *due = 0;
+    for (uint8_t i = 0; i < chip_count; i++) {
+      if (chips[i].next_conversion_ns <= target_ns &&
+          (!due || chips[i].next_conversion_ns < due->next_conversion_ns)) {
+        due = &chips[i];
+      }
+    }
+    if (!due) {
+      break;
+    }
+    if (now_ns < due->next_conversion_ns) {
+      now_ns = due->next_conversion_ns;
+    }
+    if (sck_high && now_ns - sck_high_since_ns >= 60000) {
+      for (uint8_t i = 0; i < chip_count; i++) {
+        chips[i].powered_down = true;
+        pin_level[chips[i].dout] = HIGH;
+        chips[i].ready = false;
+      }
+    }
+    due->next_conversion_ns += (uint64_t) due->period_us * 1000;
+    hxConversion(*due);
+  }
+  if (now_ns < target_ns) {
+    now_ns = target_ns;
+  }
+}
+
+void simAdvanceNanos(uint32_t ns) {
+  hxAdvanceTo(now_ns + ns);
+}
+
+void simAdvance(uint64_t us) {
+  hxAdvanceTo(now_ns + us * 1000);
+}
+
+uint64_t simMicros() {
+  return now_ns / 1000;
+}
+
+void simHX711Attach(uint8_t doutPin, uint8_t sckPin) {
+  chip_count = 0;
+  hx_sck = sckPin;
+  simHX711AttachChannel(0, doutPin);
+}
+
+void simHX711AttachChannel(uint8_t channel, uint8_t doutPin) {
+  if (channel >= SIM_HX711_MAX_CHIPS) {
+    return;
+  }
+  chips[channel] = SimHX711();
+  chips[channel].dout = doutPin;
+  chips[channel].next_conversion_ns = UINT64_MAX;
+  pin_level[doutPin] = HIGH;
+  if (channel >= chip_count) {
+    chip_count = channel + 1;
+  }
+}
+
+void simHX711FeedChannel(uint8_t channel, const int32_t *samples, size_t count, uint32_t periodUs) {
+  if (channel >= chip_count) {
+    return;
+  }
+  SimHX711 &hx = chips[channel];
+  hx.samples.assign(samples, samples + count);
+  hx.next = 0;
+  hx.period_us = periodUs;
+  hx.next_conversion_ns = now_ns + (uint64_t) periodUs * 1000;
+}
+
+void simHX711Feed(const int32_t *samples, size_t count, uint32_t periodUs) {
+  simHX711FeedChannel(0, samples, count, periodUs);
+}
+
+size_t simHX711Produced() {
+  return chip_count ? chips[0].next : 0;
+}
+
+bool simHX711Exhausted() {
+  for (uint8_t i = 0; i < chip_count; i++) {
+    if (chips[i].next < chips[i].samples.size() || chips[i].ready) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool simHX711PoweredDown() {
+  return chip_count && (chips[0].powered_down || (sck_high && now_ns - sck_high_since_ns >= 60000));
+}
+
+uint64_t simHX711DownMicros() {
+  uint64_t ns = hx_down_ns;
+  if (sck_high && now_ns - sck_high_since_ns >= 60000) {
+    ns += now_ns - sck_high_since_ns - 60000;
+  }
+  return ns / 1000;
+}
+
+// ---------------------------------------------------------------- sleep
+
+static uint64_t slept_ns = 0;
+
+// The board's version is in power_manager.cpp; here the MCU sleeps by
+// letting the time pass (pin interrupts are detached by then)
+void powerDownSleep() {
+  uint64_t from = now_ns;
+  simAdvance((uint64_t) POWER_SLEEP_MS * 1000);
+  slept_ns += now_ns - from;
+}
+
+uint64_t simSleptMicros() {
+  return slept_ns / 1000;
+}
+
+// ---------------------------------------------------------------- Arduino core
+
+unsigned long millis() {
+  // Charged like the real call, which also lets busy-waits on millis() end
+  simAdvanceNanos(SIM_MILLIS_NS);
+  return (unsigned long) (now_ns / 1000000);
+}
+
+unsigned long micros() {
+  return (unsigned long) (now_ns / 1000);
+}
+
+void delay(unsigned long ms) {
+  simAdvance((uint64_t) ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  simAdvance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void) pin;
+  (void) mode;
+  simAdvanceNanos(SIM_PIN_IO_NS);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  simAdvanceNanos(SIM_PIN_IO_NS);
+  if (pin >= NUM_DIGITAL_PINS) {
+    return;
+  }
+  if (pin == hx_sck) {
+    hxSck(val != LOW);
+  }
+  for (uint8_t i = 0; i < chip_count; i++) {
+    if (pin == chips[i].dout) {
+      return;  // driven by the chip
+    }
+  }
+  pin_level[pin] = val != LOW;
+}
+
+int digitalRead(uint8_t pin) {
+  simAdvanceNanos(SIM_PIN_IO_NS);
+  return pin < NUM_DIGITAL_PINS ? pin_level[pin] : LOW;
+}
+
+int analogRead(uint8_t pin) {
+  (void) pin;
+  simAdvance(SIM_ANALOG_READ_US);
+  return 512;
+}
+
+void analogWrite(uint8_t pin, int val) {
+  if (pin < NUM_DIGITAL_PINS) {
+    analog_level[pin] = val;
+    pin_level[pin] = val > 0;
+  }
+}
+
+int simPinLevel(uint8_t pin) {
+  return pin < NUM_DIGITAL_PINS ? pin_level[pin] : 0;
+}
+
+int simAnalogLevel(uint8_t pin) {
+  return pin < NUM_DIGITAL_PINS ? analog_level[pin] : 0;
+}
+
+void attachInterrupt(uint8_t irq, void (*isr)(), int mode) {
+  if (irq < 2) {
+    isr_handler[irq] = isr;
+    isr_mode[irq] = mode;
+    isr_pending[irq] = false;
+  }
+}
+
+void detachInterrupt(uint8_t irq) {
+  if (irq < 2) {
+    isr_handler[irq] = 0;
+    isr_pending[irq] = false;
+  }
+}
+
+void noInterrupts() {
+  interrupts_enabled = false;
+}
+
+void interrupts() {
+  interrupts_enabled = true;
+  dispatchInterrupts();
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+// ---------------------------------------------------------------- UART
+
+#define UART_TX_BUFFER 64
+
+HardwareSerial Serial;
+
+static struct {
+  unsigned long baud = 9600;
+  double tx_used = 0;       // bytes still in the TX buffer
+  uint64_t drained_at_ns = 0;
+  unsigned long sent = 0;
+  std::deque<uint8_t> captured;
+  std::deque<uint8_t> rx;
+} uart;
+
+static void uartDrain() {
+  double bytes = (now_ns - uart.drained_at_ns) * (uart.baud / 10.0) / 1e9;
+  uart.tx_used = uart.tx_used > bytes ? uart.tx_used - bytes : 0;
+  uart.drained_at_ns = now_ns;
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+  uart.baud = baud;
+  uart.tx_used = 0;
+  uart.drained_at_ns = now_ns;
+}
+
+int HardwareSerial::available() {
+  return uart.rx.size();
+}
+
+int HardwareSerial::read() {
+  if (uart.rx.empty()) {
+    return -1;
+  }
+  int c = uart.rx.front();
+  uart.rx.pop_front();
+  return c;
+}
+
+int HardwareSerial::peek() {
+  return uart.rx.empty() ? -1 : uart.rx.front();
+}
+
+int HardwareSerial::availableForWrite() {
+  uartDrain();
+  return (UART_TX_BUFFER - 1) - (int) ceil(uart.tx_used);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  // Block (in simulated time) until the buffer has room
+  while (availableForWrite() <= 0) {
+    simAdvance(10000000UL / uart.baud + 1);
+  }
+  uart.tx_used += 1;
+  uart.sent++;
+  uart.captured.push_back(c);
+  return 1;
+}
+
+void HardwareSerial::flush() {
+  while (availableForWrite() < UART_TX_BUFFER - 1) {
+    simAdvance(10000000UL / uart.baud + 1);
+  }
+}
+
+unsigned long simSerialBytesSent() {
+  return uart.sent;
+}
+
+size_t simSerialTake(uint8_t *buf, size_t max) {
+  size_t n = 0;
+  while (n < max && !uart.captured.empty()) {
+    buf[n++] = uart.captured.front();
+    uart.captured.pop_front();
+  }
+  return n;
+}
+
+void simSerialInject(const uint8_t *data, size_t len) {
+  uart.rx.insert(uart.rx.end(), data, data + len);
+}
+
+// ---------------------------------------------------------------- EEPROM
+
+EEPROMClass EEPROM;
+
+static uint8_t eeprom_mem[SIM_EEPROM_SIZE];
+static unsigned long eeprom_writes[SIM_EEPROM_SIZE];
+
+// Blank EEPROM reads as erased even before simReset()
+static struct EEPROMInit {
+  EEPROMInit() { memset(eeprom_mem, 0xFF, sizeof(eeprom_mem)); }
+} eeprom_init;
+
+uint8_t EEPROMClass::read(int idx) {
+  return idx >= 0 && idx < SIM_EEPROM_SIZE ? eeprom_mem[idx] : 0xFF;
+}
+
+void EEPROMClass::write(int idx, uint8_t val) {
+  if (idx >= 0 && idx < SIM_EEPROM_SIZE) {
+    eeprom_mem[idx] = val;
+    eeprom_writes[idx]++;
+  }
+}
+
+uint8_t *simEEPROM() {
+  return eeprom_mem;
+}
+
+unsigned long simEEPROMWrites(int address) {
+  return address >= 0 && address < SIM_EEPROM_SIZE ? eeprom_writes[address] : 0;
+}
+
+// ---------------------------------------------------------------- display
+
+// 3.5" 480x320 MCUFRIEND panel (portrait native), the size the sketch lays out for
+#define PANEL_W 320
+#define PANEL_H 480
+
+static uint16_t framebuffer[PANEL_W * PANEL_H];
+static unsigned long pixels_written = 0;
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h)
+  : WIDTH(w), HEIGHT(h), _width(w), _height(h), cursor_x(0), cursor_y(0),
+    textcolor(0xFFFF), textbgcolor(0xFFFF), textsize(1), rotation(0) {
+}
+
+void Adafruit_GFX::setRotation(uint8_t r) {
+  rotation = r & 3;
+  _width = (rotation & 1) ? HEIGHT : WIDTH;
+  _height = (rotation & 1) ? WIDTH : HEIGHT;
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  for (int16_t j = 0; j < h; j++) {
+    for (int16_t i = 0; i < w; i++) {
+      drawPixel(x + i, y + j, color);
+    }
+  }
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  drawFastHLine(x, y, w, color);
+  drawFastHLine(x, y + h - 1, w, color);
+  drawFastVLine(x, y, h, color);
+  drawFastVLine(x + w - 1, y, h, color);
+}
+
+// Stand-in glyphs: a deterministic 5x8 pattern per character, drawn the
+// way the GFX library draws its built-in font (one rect per font pixel)
+static bool glyphBit(unsigned char c, int col, int row) {
+  if (c == ' ') {
+    return false;
+  }
+  return ((c * 31 + col * 7 + row * 13) % 5) < 2;
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size) {
+  for (int col = 0; col < 6; col++) {
+    for (int row = 0; row < 8; row++) {
+      bool on = col < 5 && glyphBit(c, col, row);
+      if (on) {
+        fillRect(x + col * size, y + row * size, size, size, color);
+      } else if (bg != color) {
+        fillRect(x + col * size, y + row * size, size, size, bg);
+      }
+    }
+  }
+}
+
+void Adafruit_GFX::drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color, uint16_t bg) {
+  int16_t byteWidth = (w + 7) / 8;
+  for (int16_t j = 0; j < h; j++) {
+    for (int16_t i = 0; i < w; i++) {
+      bool on = pgm_read_byte(bitmap + j * byteWidth + i / 8) & (0x80 >> (i & 7));
+      drawPixel(x + i, y + j, on ? color : bg);
+    }
+  }
+}
+
+size_t Adafruit_GFX::write(uint8_t c) {
+  if (c == '\n') {
+    cursor_x = 0;
+    cursor_y += textsize * 8;
+  } else if (c != '\r') {
+    drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize);
+    cursor_x += textsize * 6;
+  }
+  return 1;
+}
+
+MCUFRIEND_kbv::MCUFRIEND_kbv(int, int, int, int, int)
+  : Adafruit_GFX(PANEL_W, PANEL_H), winX0(0), winY0(0), winX1(0), winY1(0), winX(0), winY(0) {
+}
+
+uint16_t MCUFRIEND_kbv::readID() {
+  simAdvance(100);
+  return 0x9341;
+}
+
+void MCUFRIEND_kbv::begin(uint16_t id) {
+  (void) id;
+  simAdvance(120000);  // reset and sleep-out delays of the controller
+}
+
+// Map rotated coordinates to the panel and store the pixel
+static void storePixel(uint8_t rotation, int16_t x, int16_t y, uint16_t color) {
+  int16_t px, py;
+  switch (rotation) {
+    case 1:  px = PANEL_W - 1 - y; py = x; break;
+    case 2:  px = PANEL_W - 1 - x; py = PANEL_H - 1 - y; break;
+    case 3:  px = y; py = PANEL_H - 1 - x; break;
+    default: px = x; py = y; break;
+  }
+  if (px >= 0 && px < PANEL_W && py >= 0 && py < PANEL_H) {
+    framebuffer[py * PANEL_W + px] = color;
+  }
+}
+
+void MCUFRIEND_kbv::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (x < 0 || y < 0 || x >= _width || y >= _height) {
+    return;
+  }
+  storePixel(rotation, x, y, color);
+  pixels_written++;
+  simAdvanceNanos(SIM_WINDOW_NS + SIM_PIXEL_NS);
+}
+
+void MCUFRIEND_kbv::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  // Clip, then one address window and a run of identical pixels
+  if (w < 0) { x += w; w = -w; }
+  if (h < 0) { y += h; h = -h; }
+  int16_t x1 = x + w, y1 = y + h;
+  if (x < 0) x = 0;
+  if (y < 0) y = 0;
+  if (x1 > _width) x1 = _width;
+  if (y1 > _height) y1 = _height;
+  if (x >= x1 || y >= y1) {
+    return;
+  }
+  for (int16_t j = y; j < y1; j++) {
+    for (int16_t i = x; i < x1; i++) {
+      storePixel(rotation, i, j, color);
+    }
+  }
+  unsigned long n = (unsigned long) (x1 - x) * (y1 - y);
+  pixels_written += n;
+  simAdvanceNanos(SIM_WINDOW_NS);
+  simAdvance(n * SIM_PIXEL_NS / 1000);
+}
+
+void MCUFRIEND_kbv::setAddrWindow(int16_t x, int16_t y, int16_t x1, int16_t y1) {
+  winX0 = winX = x;
+  winY0 = winY = y;
+  winX1 = x1;
+  winY1 = y1;
+  simAdvanceNanos(SIM_WINDOW_NS);
+}
+
+void MCUFRIEND_kbv::pushColors(uint16_t *block, int16_t n, bool first) {
+  if (first) {
+    winX = winX0;
+    winY = winY0;
+  }
+  for (int16_t i = 0; i < n; i++) {
+    storePixel(rotation, winX, winY, block[i]);
+    if (++winX > winX1) {
+      winX = winX0;
+      winY++;
+    }
+  }
+  pixels_written += n;
+  simAdvance((unsigned long) n * SIM_PIXEL_NS / 1000);
+}
+
+void MCUFRIEND_kbv::pushColors(const uint8_t *block, int16_t n, bool first, bool bigend) {
+  uint16_t px[64];
+  while (n > 0) {
+    int16_t chunk = n > 64 ? 64 : n;
+    for (int16_t i = 0; i < chunk; i++) {
+      uint8_t a = pgm_read_byte(block++), b = pgm_read_byte(block++);
+      px[i] = bigend ? (a << 8 | b) : (b << 8 | a);
+    }
+    pushColors(px, chunk, first);
+    first = false;
+    n -= chunk;
+  }
+}
+
+void MCUFRIEND_kbv::vertScroll(int16_t, int16_t, int16_t) {
+}
+
+uint16_t MCUFRIEND_kbv::readPixel(int16_t x, int16_t y) {
+  return simFramebufferPixel(x, y);
+}
+
+unsigned long simPixelsWritten() {
+  return pixels_written;
+}
+
+uint16_t simFramebufferPixel(int16_t x, int16_t y) {
+  if (x < 0 || y < 0 || x >= PANEL_W || y >= PANEL_H) {
+    return 0;
+  }
+  return framebuffer[y * PANEL_W + x];
+}
+
+// ---------------------------------------------------------------- touch
+
+static TSPoint touch_point;
+
+TouchScreen::TouchScreen(uint8_t, uint8_t, uint8_t, uint8_t, uint16_t) : pressureThreshhold(10) {
+}
+
+TSPoint TouchScreen::getPoint() {
+  // Four ADC conversions plus settling, roughly what the library does
+  simAdvance(4 * SIM_ANALOG_READ_US + 40);
+  return touch_point;
+}
+
+uint16_t TouchScreen::pressure() {
+  simAdvance(2 * SIM_ANALOG_READ_US);
+  return touch_point.z;
+}
+
+void simTouch(int16_t x, int16_t y, int16_t z) {
+  touch_point = TSPoint(x, y, z);
+}
+
+// ---------------------------------------------------------------- SD card
+
+// SDHC card in SPI mode. Commands are collected byte by byte while CS is
+// low; responses queue up in sd.out and go out on the following
+// transfers. Blocks are stored sparsely and read erased (0xFF) until
+// written.
+SPIClass SPI;
+
+enum SimSDMode {
+  SD_MODE_COMMAND,
+  SD_MODE_WRITE_TOKEN,  // after CMD24, waiting for the start token
+  SD_MODE_WRITE_DATA
+};
+
+static struct {
+  bool attached;
+  uint8_t cs;
+  uint32_t blocks;
+  std::map<uint32_t, std::vector<uint8_t> > image;
+  uint32_t clock;
+  SimSDMode mode;
+  uint8_t cmd[6];
+  uint8_t cmd_len;
+  bool app_cmd;
+  bool ready;
+  uint64_t ready_at_ns;
+  uint64_t busy_until_ns;
+  uint32_t write_block;
+  std::vector<uint8_t> write_buf;
+  std::deque<uint8_t> out;
+  unsigned long blocks_written;
+  unsigned long blocks_read;
+} sd;
+
+static void sdCommand() {
+  uint8_t index = sd.cmd[0] & 0x3F;
+  uint32_t arg = (uint32_t) sd.cmd[1] << 24 | (uint32_t) sd.cmd[2] << 16 | sd.cmd[3] << 8 | sd.cmd[4];
+  bool app = sd.app_cmd;
+  sd.app_cmd = false;
+  uint8_t idle = sd.ready ? 0x00 : 0x01;
+
+  sd.out.push_back(0xFF);  // NCR: one byte before the response
+  switch (index) {
+    case 0:
+      sd.ready = false;
+      sd.ready_at_ns = now_ns + (uint64_t) SIM_SD_START_US * 1000;
+      sd.out.push_back(0x01);
+      break;
+    case 8:
+      sd.out.push_back(idle);
+      sd.out.push_back(0x00);
+      sd.out.push_back(0x00);
+      sd.out.push_back(arg >> 8 & 0x0F);
+      sd.out.push_back(arg & 0xFF);
+      break;
+    case 55:
+      sd.app_cmd = true;
+      sd.out.push_back(idle);
+      break;
+    case 41:
+      if (app && now_ns >= sd.ready_at_ns) {
+        sd.ready = true;
+      }
+      sd.out.push_back(app ? (sd.ready ? 0x00 : 0x01) : 0x04);
+      break;
+    case 58:
+      sd.out.push_back(idle);
+      sd.out.push_back(sd.ready ? 0xC0 : 0x80);  // powered up, CCS (block addressed)
+      sd.out.push_back(0xFF);
+      sd.out.push_back(0x80);
+      sd.out.push_back(0x00);
+      break;
+    case 17:
+      if (!sd.ready || arg >= sd.blocks) {
+        sd.out.push_back(sd.ready ? 0x40 : 0x04);  // address error / illegal
+        break;
+      }
+      sd.out.push_back(0x00);
+      for (int i = 0; i < SIM_SD_READ_WAIT_BYTES; i++) {
+        sd.out.push_back(0xFF);
+      }
+      sd.out.push_back(0xFE);
+      for (int i = 0; i < SIM_SD_BLOCK_SIZE; i++) {
+        const uint8_t *b = simSDBlock(arg);
+        sd.out.push_back(b ? b[i] : 0xFF);
+      }
+      sd.out.push_back(0xFF);
+      sd.out.push_back(0xFF);
+      sd.blocks_read++;
+      break;
+    case 24:
+      if (!sd.ready || arg >= sd.blocks) {
+        sd.out.push_back(sd.ready ? 0x40 : 0x04);
+        break;
+      }
+      sd.out.push_back(0x00);
+      sd.write_block = arg;
+      sd.mode = SD_MODE_WRITE_TOKEN;
+      break;
+    default:
+      sd.out.push_back(idle | 0x04);
+      break;
+  }
+}
+
+void SPIClass::beginTransaction(SPISettings settings) {
+  sd.clock = settings.clock;
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+  simAdvanceNanos((uint32_t) (8000000000ULL / (sd.clock ? sd.clock : 4000000)) + SIM_SPI_BYTE_NS);
+  if (!sd.attached || pin_level[sd.cs]) {
+    return 0xFF;
+  }
+
+  uint8_t reply;
+  if (!sd.out.empty()) {
+    reply = sd.out.front();
+    sd.out.pop_front();
+  } else if (now_ns < sd.busy_until_ns) {
+    return 0x00;  // programming, MISO held low
+  } else {
+    reply = 0xFF;
+  }
+
+  switch (sd.mode) {
+    case SD_MODE_COMMAND:
+      if (sd.cmd_len > 0 || (data & 0xC0) == 0x40) {
+        sd.cmd[sd.cmd_len++] = data;
+        if (sd.cmd_len == 6) {
+          sd.cmd_len = 0;
+          sdCommand();
+        }
+      }
+      break;
+    case SD_MODE_WRITE_TOKEN:
+      if (data == 0xFE) {
+        sd.write_buf.clear();
+        sd.mode = SD_MODE_WRITE_DATA;
+      }
+      break;
+    case SD_MODE_WRITE_DATA:
+      sd.write_buf.push_back(data);
+      if (sd.write_buf.size() == SIM_SD_BLOCK_SIZE + 2) {  // data and CRC-16
+        sd.write_buf.resize(SIM_SD_BLOCK_SIZE);
+        sd.image[sd.write_block] = sd.write_buf;
+        sd.blocks_written++;
+        sd.out.push_back(0xE5);  // data accepted
+        sd.busy_until_ns = now_ns + (uint64_t) SIM_SD_WRITE_BUSY_US * 1000;
+        sd.mode = SD_MODE_COMMAND;
+      }
+      break;
+  }
+  return reply;
+}
+
+void simSDAttach(uint8_t csPin, uint32_t blocks) {
+  sd.attached = true;
+  sd.cs = csPin;
+  sd.blocks = blocks;
+}
+
+const uint8_t *simSDBlock(uint32_t block) {
+  std::map<uint32_t, std::vector<uint8_t> >::const_iterator it = sd.image.find(block);
+  return it == sd.image.end() ? 0 : it->second.data();
+}
+
+void simSDWriteBlock(uint32_t block, const uint8_t *data) {
+  sd.image[block] = std::vector<uint8_t>(data, data + SIM_SD_BLOCK_SIZE);
+}
+
+uint32_t simSDBlocksUsed() {
+  return sd.image.empty() ? 0 : sd.image.rbegin()->first + 1;
+}
+
+unsigned long simSDBlocksWritten() {
+  return sd.blocks_written;
+}
+
+unsigned long simSDBlocksRead() {
+  return sd.blocks_read;
+}
+
+// ---------------------------------------------------------------- reset
+
+void simReset() {
+  now_ns = 0;
+  memset(pin_level, 0, sizeof(pin_level));
+  memset(analog_level, 0, sizeof(analog_level));
+  isr_handler[0] = isr_handler[1] = 0;
+  isr_pending[0] = isr_pending[1] = false;
+  interrupts_enabled = true;
+  in_isr = false;
+  for (uint8_t i = 0; i < SIM_HX711_MAX_CHIPS; i++) {
+    chips[i] = SimHX711();
+  }
+  chip_count = 0;
+  hx_sck = 0xFF;
+  hx_down_ns = 0;
+  slept_ns = 0;
+  sck_high = false;
+  uart.tx_used = 0;
+  uart.drained_at_ns = 0;
+  uart.sent = 0;
+  uart.captured.clear();
+  uart.rx.clear();
+  memset(eeprom_mem, 0xFF, sizeof(eeprom_mem));
+  memset(eeprom_writes, 0, sizeof(eeprom_writes));
+  memset(framebuffer, 0, sizeof(framebuffer));
+  pixels_written = 0;
+  touch_point = TSPoint();
+  sd.attached = false;
+  sd.image.clear();
+  sd.clock = 0;
+  sd.mode = SD_MODE_COMMAND;
+  sd.cmd_len = 0;
+  sd.app_cmd = false;
+  sd.ready = false;
+  sd.ready_at_ns = 0;
+  sd.busy_until_ns = 0;
+  sd.out.clear();
+  sd.blocks_written = 0;
+  sd.blocks_read = 0;
+}
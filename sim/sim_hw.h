@@ -0,0 +1,100 @@
+/**
+ * Harness side of the simulated Uno used by the host build.
+ *
+ * Simulated time only moves when the harness calls simAdvance() or when
+ * the sketch calls something that takes time on the real board (delay(),
+ * pin I/O, pixel writes). Device models hang off
+ * that clock:
+ *
+ * - HX711: up to four chips on one SCK line. Each produces one conversion
+ *   per period from its fed trace, pulls DOUT low (firing the pin interrupt
+ *   if attached), answers the 24 + gain bit SCK protocol and powers down
+ *   when SCK is held high for >60 us. The trace keeps time meanwhile:
+ *   conversions while powered down or settling are skipped.
+ * - TFT: RGB565 framebuffer; every pixel written costs SIM_PIXEL_NS.
+ * - UART: 64-byte TX buffer drained at the baud rate; bytes are captured.
+ * - Touch: returns the point injected with simTouch().
+ * - EEPROM: 1 KB, starts erased, counts writes per cell.
+ * - Sleep: powerDownSleep() (power_manager.h) lets POWER_SLEEP_MS pass,
+ *   counted as time asleep.
+ * - SD card: SDHC in SPI mode on the hardware SPI pins when attached with
+ *   simSDAttach(); starts up SIM_SD_START_US after CMD0 and is busy for
+ *   SIM_SD_WRITE_BUSY_US after each block written. Unwritten blocks read
+ *   erased (0xFF).
+ */
+
+#ifndef SIM_HW_H
+#define SIM_HW_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Cost model (simulated time)
+#define SIM_PIXEL_NS      400   // one 16-bit pixel over the 8-bit bus
+#define SIM_WINDOW_NS     4000  // setting an address window
+#define SIM_PIN_IO_NS     3500  // digitalRead / digitalWrite
+#define SIM_MILLIS_NS     1000  // millis(), reads timer0 state with interrupts masked
+#define SIM_ANALOG_READ_US 110
+#define SIM_HX711_WAKE_US 50000 // settling time after leaving power-down
+#define SIM_SPI_BYTE_NS   500   // SPI.transfer() overhead on top of the 8 clocks
+#define SIM_SD_START_US   80000 // ACMD41 answers "idle" until this long after CMD0
+#define SIM_SD_WRITE_BUSY_US 2500
+#define SIM_SD_READ_WAIT_BYTES 20 // 0xFF bytes before a read's data token
+
+void simReset();
+
+// Clock
+uint64_t simMicros();
+void simAdvance(uint64_t us);
+void simAdvanceNanos(uint32_t ns);
+
+// HX711 model. Samples are raw 24-bit counts, one per conversion period.
+// simHX711Attach() wires channel 0 and the shared SCK pin (detaching any
+// other channels); further chips on the same SCK get their own DOUT pin,
+// trace and conversion period.
+#define SIM_HX711_MAX_CHIPS 4
+void simHX711Attach(uint8_t doutPin, uint8_t sckPin);
+void simHX711AttachChannel(uint8_t channel, uint8_t doutPin);
+void simHX711Feed(const int32_t *samples, size_t count, uint32_t periodUs);
+void simHX711FeedChannel(uint8_t channel, const int32_t *samples, size_t count, uint32_t periodUs);
+size_t simHX711Produced();
+bool simHX711Exhausted();
+bool simHX711PoweredDown();
+uint64_t simHX711DownMicros();  // total time powered down
+
+// MCU sleep
+uint64_t simSleptMicros();
+
+// Touch: raw touchscreen coordinates as TouchScreen::getPoint() reports
+// them; z = 0 releases
+void simTouch(int16_t x, int16_t y, int16_t z);
+
+// TFT
+unsigned long simPixelsWritten();
+uint16_t simFramebufferPixel(int16_t x, int16_t y);  // panel coordinates
+
+// UART
+unsigned long simSerialBytesSent();
+size_t simSerialTake(uint8_t *buf, size_t max);    // drain captured TX bytes
+void simSerialInject(const uint8_t *data, size_t len);
+
+// EEPROM
+#define SIM_EEPROM_SIZE 1024
+uint8_t *simEEPROM();
+unsigned long simEEPROMWrites(int address);
+
+// SD card: blocks of SIM_SD_BLOCK_SIZE bytes; simSDBlock() is null for a
+// block never written, simSDBlocksUsed() one past the highest written
+#define SIM_SD_BLOCK_SIZE 512
+void simSDAttach(uint8_t csPin, uint32_t blocks);
+const uint8_t *simSDBlock(uint32_t block);
+void simSDWriteBlock(uint32_t block, const uint8_t *data);
+uint32_t simSDBlocksUsed();
+unsigned long simSDBlocksWritten();
+unsigned long simSDBlocksRead();
+
+// Output pins and PWM as last written by the sketch
+int simPinLevel(uint8_t pin);
+int simAnalogLevel(uint8_t pin);
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * Globals defined in ../main.cpp that the host harness inspects. main.cpp
+ * has no header of its own since on the board it is the sketch.
+ */
+
+#ifndef SIM_SKETCH_H
+#define SIM_SKETCH_H
+
+#include <Arduino.h>
+#include "../scheduler.h"
+#include "../hx711_sampler.h"
+#include "../telemetry.h"
+#include "../load_detector.h"
+#include "../profiler.h"
+#include "../config_store.h"
+#include "../bulk_log.h"
+#include "../power_manager.h"
+
+// Pins, as wired in main.cpp
+#define SKETCH_HX711_DT  3
+#define SKETCH_HX711_SCK 2
+#define SKETCH_SD_CS     10
+#define SKETCH_BACKLIGHT_PIN 11
+
+// Sketch build options the harness needs to agree with
+#ifndef BACKLIGHT_ENABLED
+#define BACKLIGHT_ENABLED 0
+#endif
+
+void setup();
+void loop();
+
+extern Task tasks[];
+extern Scheduler scheduler;
+extern HX711Sampler sampler;
+extern Telemetry telemetry;
+extern LoadDetector detector;
+extern PowerManager power;
+#if PROFILER_ENABLED
+extern Profiler profiler;
+#endif
+#if BULK_LOG_ENABLED
+extern BulkLog bulkLog;
+#endif
+
+extern int32_t current_weight;
+extern int64_t total_weight;
+extern int load_count;
+extern bool scale_zeroed;
+extern DeviceConfig config;
+
+#endif
@@ -0,0 +1,75 @@
+#include "trace.h"
+#include <fstream>
+#include <iostream>
+#include <stdlib.h>
+
+static std::string trim(const std::string &s) {
+  size_t b = s.find_first_not_of(" \t\r");
+  size_t e = s.find_last_not_of(" \t\r");
+  return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+}
+
+unsigned Trace::rate() const {
+  long r = number("rate", 80);
+  return r > 0 ? (unsigned) r : 80;
+}
+
+long Trace::calFactor() const {
+  return number("cal_factor", 0);
+}
+
+long Trace::number(const std::string &key, long fallback) const {
+  std::map<std::string, std::string>::const_iterator it = meta.find(key);
+  return it == meta.end() ? fallback : strtol(it->second.c_str(), 0, 10);
+}
+
+std::vector<long> Trace::numbers(const std::string &key) const {
+  std::vector<long> list;
+  std::map<std::string, std::string>::const_iterator it = meta.find(key);
+  if (it != meta.end()) {
+    const char *p = it->second.c_str();
+    char *end;
+    for (long v = strtol(p, &end, 10); end != p; v = strtol(p, &end, 10)) {
+      list.push_back(v);
+      p = end;
+    }
+  }
+  return list;
+}
+
+bool loadTrace(const char *path, Trace &trace) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << path << ": cannot open trace\n";
+    return false;
+  }
+
+  trace.path = path;
+  trace.samples.clear();
+  trace.meta.clear();
+
+  std::string line;
+  unsigned lineNo = 0;
+  while (std::getline(in, line)) {
+    lineNo++;
+    line = trim(line);
+    if (line.empty()) {
+      continue;
+    }
+    if (line[0] == '#') {
+      size_t colon = line.find(':');
+      if (colon != std::string::npos) {
+        trace.meta[trim(line.substr(1, colon - 1))] = trim(line.substr(colon + 1));
+      }
+      continue;
+    }
+    char *end;
+    long v = strtol(line.c_str(), &end, 10);
+    if (*end != '\0') {
+      std::cerr << path << ":" << lineNo << ": not a sample: " << line << "\n";
+      return false;
+    }
+    trace.samples.push_back((int32_t) v);
+  }
+  return true;
+}
@@ -0,0 +1,41 @@
+/**
+ * Recorded (or generated) HX711 traces for the host harness.
+ *
+ * A trace is a text file with one raw 24-bit count per line, in conversion
+ * order. Lines starting with '#' are comments; "# key: value" comments are
+ * metadata, e.g.
+ *
+ *   # rate: 80              conversions per second
+ *   # cal_factor: -200      raw counts per kg the trace was recorded with
+ *   # expect_loads: 1       anything else is kept for the tools to use
+ *
+ * bench --check reads the expected outcome: expect_loads,
+ * expect_payload_kg, expect_unloaded_at (the sample index at which each
+ * load is off the scale, space separated) and optionally its own limits,
+ * max_payload_error_kg and max_latency_samples.
+ */
+
+#ifndef SIM_TRACE_H
+#define SIM_TRACE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+struct Trace {
+  std::string path;
+  std::vector<int32_t> samples;
+  std::map<std::string, std::string> meta;
+
+  unsigned rate() const;
+  long calFactor() const;  // 0 if the trace doesn't say
+  bool has(const std::string &key) const { return meta.count(key) != 0; }
+  long number(const std::string &key, long fallback = 0) const;
+  std::vector<long> numbers(const std::string &key) const;  // space separated
+};
+
+// Returns false (with a message on stderr) if the file can't be read
+bool loadTrace(const char *path, Trace &trace);
+
+#endif
@@ -0,0 +1,260 @@
+// Synthetic HX711 trace generator for the host harness.
+//
+//   tracegen <scenario> [seed] > traces/<scenario>.csv
+//
+// Each scenario is a list of segments describing the weight on the scale;
+// the generator turns it into raw counts with the given offset, calibration
+// factor, sensor noise and zero drift, and records the expected outcome as
+// metadata: the number of loads, the payload of each and the sample at
+// which each is off the scale again (expect_unloaded_at, where the
+// detection latency is measured from; bench --check).
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RATE 80
+
+enum SegmentKind { HOLD, RAMP, STEPS, VIBRATE };
+
+struct Segment {
+  SegmentKind kind;
+  double seconds;
+  double kg;         // target weight (HOLD/RAMP/STEPS), amplitude (VIBRATE)
+  double param;      // steps (STEPS), frequency in Hz (VIBRATE)
+};
+
+struct Scenario {
+  const char *name;
+  const char *description;
+  long offset;       // raw counts with the scale empty
+  long calFactor;    // raw counts per kg
+  double noise;      // sensor noise, counts RMS
+  int expectLoads;
+  double expectPayload;  // kg, of each load
+  Segment segments[16];
+  int count;
+  double driftPerHour;   // kg per hour the empty reading creeps by
+  int maxErrorKg;        // bench --check limits, just above what the
+  int maxLatency;        // sketch gets (samples)
+};
+
+static const Scenario scenarios[] = {
+  {
+    "single_load", "one 18 t load: bucket loading, a drive, tipping",
+    120000, -200, 15, 1, 18000,
+    {
+      { HOLD,    5,  0,     0 },
+      { STEPS,   12, 18000, 4 },
+      { HOLD,    5,  18000, 0 },
+      { VIBRATE, 10, 400,   3 },
+      { HOLD,    5,  18000, 0 },
+      { RAMP,    8,  0,     0 },
+      { HOLD,    5,  0,     0 },
+    },
+    7, 0, 1, 12
+  },
+  {
+    "zero_drift", "two 18 t loads while the empty reading drifts 3 kg",
+    120000, -200, 15, 2, 18000,
+    {
+      { HOLD,    60, 0,     0 },
+      { STEPS,   12, 18000, 4 },
+      { HOLD,    10, 18000, 0 },
+      { RAMP,    8,  0,     0 },
+      { HOLD,    60, 0,     0 },
+      { STEPS,   12, 18000, 4 },
+      { HOLD,    10, 18000, 0 },
+      { RAMP,    8,  0,     0 },
+      { HOLD,    20, 0,     0 },
+    },
+    9, 54, 1, 12
+  },
+  {
+    "heavy_load", "one 42 t load on a scale with a wider range",
+    120000, -100, 15, 1, 42000,
+    {
+      { HOLD,    5,  0,     0 },
+      { STEPS,   16, 42000, 6 },
+      { HOLD,    5,  42000, 0 },
+      { VIBRATE, 10, 800,   3 },
+      { HOLD,    5,  42000, 0 },
+      { RAMP,    10, 0,     0 },
+      { HOLD,    5,  0,     0 },
+    },
+    7, 0, 1, 12
+  },
+  {
+    "parked", "an 18 t load after three minutes parked (idle mode)",
+    120000, -200, 15, 1, 18000,
+    {
+      { HOLD,    180, 0,     0 },
+      { STEPS,   12,  18000, 4 },
+      { HOLD,    10,  18000, 0 },
+      { RAMP,    8,   0,     0 },
+      { HOLD,    10,  0,     0 },
+    },
+    5, 0, 1, 12
+  },
+  {
+    "vibration", "one 18 t load driven over a rough road",
+    120000, -200, 15, 1, 18000,
+    {
+      { HOLD,    5,  0,     0 },
+      { STEPS,   12, 18000, 4 },
+      { HOLD,    5,  18000, 0 },
+      { VIBRATE, 30, 1500,  2 },
+      { VIBRATE, 10, 3000,  7 },
+      { HOLD,    5,  18000, 0 },
+      { RAMP,    8,  0,     0 },
+      { HOLD,    5,  0,     0 },
+    },
+    8, 0, 1, 12
+  },
+  {
+    "bumps", "someone climbing on the empty bed, then one 18 t load",
+    120000, -200, 15, 1, 18000,
+    {
+      { HOLD,    5,   0,     0 },
+      { RAMP,    1,   2500,  0 },
+      { RAMP,    1,   0,     0 },
+      { HOLD,    5,   0,     0 },
+      { RAMP,    0.5, 1500,  0 },
+      { RAMP,    0.5, 0,     0 },
+      { HOLD,    5,   0,     0 },
+      { STEPS,   12,  18000, 4 },
+      { HOLD,    5,   18000, 0 },
+      { RAMP,    8,   0,     0 },
+      { HOLD,    5,   0,     0 },
+      { RAMP,    1,   2000,  0 },
+      { RAMP,    1.5, 0,     0 },
+      { HOLD,    5,   0,     0 },
+    },
+    14, 0, 1, 12
+  },
+  {
+    "partial_unload", "one 18 t load tipped in two goes",
+    120000, -200, 15, 1, 18000,
+    {
+      { HOLD,    5,  0,     0 },
+      { STEPS,   12, 18000, 4 },
+      { HOLD,    5,  18000, 0 },
+      { RAMP,    4,  9000,  0 },
+      { HOLD,    5,  9000,  0 },
+      { RAMP,    4,  0,     0 },
+      { HOLD,    5,  0,     0 },
+    },
+    7, 0, 1, 12
+  },
+};
+
+static uint64_t rng_state;
+
+static double uniform() {
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return ((rng_state * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gaussian() {
+  double u = uniform(), v = uniform();
+  return sqrt(-2.0 * log(u + 1e-300)) * cos(2 * M_PI * v);
+}
+
+static long emitted;
+
+static void emit(const Scenario &s, double kg) {
+  double drift = s.driftPerHour * emitted++ / (RATE * 3600.0);
+  long counts = s.offset + lround((kg + drift) * s.calFactor + gaussian() * s.noise);
+  if (counts > 0x7FFFFF) counts = 0x7FFFFF;
+  if (counts < -0x800000) counts = -0x800000;
+  printf("%ld\n", counts);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: tracegen <scenario> [seed]\nscenarios:\n");
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+      fprintf(stderr, "  %-14s %s\n", scenarios[i].name, scenarios[i].description);
+    }
+    return 2;
+  }
+
+  const Scenario *s = 0;
+  for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    if (strcmp(argv[1], scenarios[i].name) == 0) {
+      s = &scenarios[i];
+    }
+  }
+  if (!s) {
+    fprintf(stderr, "tracegen: unknown scenario '%s'\n", argv[1]);
+    return 2;
+  }
+  rng_state = argc > 2 ? strtoull(argv[2], 0, 0) : 0x9E3779B97F4A7C15ULL;
+  if (rng_state == 0) {
+    rng_state = 1;
+  }
+
+  printf("# %s: %s (generated by tracegen)\n", s->name, s->description);
+  printf("# rate: %d\n", RATE);
+  printf("# cal_factor: %ld\n", s->calFactor);
+  printf("# expect_loads: %d\n", s->expectLoads);
+  printf("# expect_payload_kg: %ld\n", lround(s->expectPayload));
+  printf("# max_payload_error_kg: %d\n", s->maxErrorKg);
+  printf("# max_latency_samples: %d\n", s->maxLatency);
+
+  // A load is off the scale at the end of the segment that takes the
+  // weight from at least half the payload back to zero
+  printf("# expect_unloaded_at:");
+  double level = 0;
+  long at = 0;
+  for (int i = 0; i < s->count; i++) {
+    const Segment &seg = s->segments[i];
+    at += lround(seg.seconds * RATE);
+    if (seg.kind != VIBRATE) {
+      if (seg.kg == 0 && level >= s->expectPayload / 2) {
+        printf(" %ld", at);
+      }
+      level = seg.kg;
+    }
+  }
+  printf("\n");
+
+  double kg = 0;
+  for (int i = 0; i < s->count; i++) {
+    const Segment &seg = s->segments[i];
+    int n = lround(seg.seconds * RATE);
+    double from = kg;
+    for (int k = 0; k < n; k++) {
+      double t = (double) k / n;
+      switch (seg.kind) {
+        case HOLD:
+          kg = seg.kg;
+          emit(*s, kg);
+          break;
+        case RAMP:
+          kg = from + (seg.kg - from) * (k + 1) / n;
+          emit(*s, kg);
+          break;
+        case STEPS: {
+          // Each bucket lands over the first fifth of its step
+          double step = t * seg.param;
+          double whole = floor(step);
+          double frac = step - whole;
+          double landed = frac < 0.2 ? frac / 0.2 : 1.0;
+          kg = from + (seg.kg - from) * (whole + landed) / seg.param;
+          emit(*s, kg);
+          break;
+        }
+        case VIBRATE:
+          emit(*s, kg + seg.kg * sin(2 * M_PI * seg.param * k / RATE) * (0.5 + 0.5 * uniform()));
+          break;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,143 @@
+#include "telemetry.h"
+#include "crc8.h"
+#include "sample_codec.h"
+
+static void putU16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void putU32(uint8_t *p, uint32_t v) {
+  for (uint8_t i = 0; i < 4; i++) {
+    p[i] = v >> (8 * i);
+  }
+}
+
+Telemetry::Telemetry() : dropped(0), batchLen(0), batchRaw(0), batchGrams(0), batchStarted(0) {
+  batch[0] = 0;
+}
+
+void Telemetry::begin(unsigned long baud) {
+  Serial.begin(baud);
+}
+
+void Telemetry::sendSample(int32_t raw, int32_t grams) {
+  if (batch[0] != 0 &&
+      batchLen + deltaSize(batchRaw, raw) + deltaSize(batchGrams, grams) > TELEMETRY_MAX_PAYLOAD) {
+    sendBatch();
+  }
+  if (batch[0] == 0) {
+    putU32(batch + 1, (uint32_t) raw);
+    putU32(batch + 5, (uint32_t) grams);
+    batchLen = 9;
+    batchRaw = raw;
+    batchGrams = grams;
+    batchStarted = millis();
+  } else {
+    batchLen += putDelta(batch + batchLen, batchRaw, raw);
+    batchLen += putDelta(batch + batchLen, batchGrams, grams);
+  }
+  if (++batch[0] == TELEMETRY_BATCH_SAMPLES) {
+    sendBatch();
+  }
+}
+
+void Telemetry::sendBatch() {
+  send(TELEMETRY_SAMPLES, batch, batchLen);
+  batch[0] = 0;
+}
+
+void Telemetry::sendLoad(unsigned long endedAt, int32_t payloadWeight, int32_t peak, uint16_t duration) {
+  uint8_t payload[14];
+  putU32(payload, endedAt);
+  putU32(payload + 4, (uint32_t) payloadWeight);
+  putU32(payload + 8, (uint32_t) peak);
+  putU16(payload + 12, duration);
+  send(TELEMETRY_LOAD, payload, sizeof(payload));
+}
+
+bool Telemetry::sendProfile(uint8_t section, uint32_t count, uint16_t min, uint16_t max, uint16_t avg, uint16_t overruns) {
+  uint8_t payload[13];
+  payload[0] = section;
+  putU32(payload + 1, count);
+  putU16(payload + 5, min);
+  putU16(payload + 7, max);
+  putU16(payload + 9, avg);
+  putU16(payload + 11, overruns);
+  return send(TELEMETRY_PROFILE, payload, sizeof(payload));
+}
+
+bool Telemetry::sendStats(uint8_t kind, uint16_t count, int64_t sum, int32_t min, int32_t max, int32_t mean, int32_t stddev) {
+  uint8_t payload[TELEMETRY_STATS_SIZE];
+  packStats(payload, kind, count, sum, min, max, mean, stddev);
+  return send(TELEMETRY_STATS, payload, sizeof(payload));
+}
+
+void Telemetry::packStats(uint8_t *dst, uint8_t kind, uint16_t count, int64_t sum, int32_t min, int32_t max, int32_t mean, int32_t stddev) {
+  dst[0] = kind;
+  putU16(dst + 1, count);
+  putU32(dst + 3, (uint32_t) sum);
+  putU32(dst + 7, (uint32_t) ((uint64_t) sum >> 32));
+  putU32(dst + 11, (uint32_t) min);
+  putU32(dst + 15, (uint32_t) max);
+  putU32(dst + 19, (uint32_t) mean);
+  putU32(dst + 23, (uint32_t) stddev);
+}
+
+bool Telemetry::sendReply(uint8_t type, uint8_t status, const uint8_t *data, uint8_t len) {
+  uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+  if (len >= TELEMETRY_MAX_PAYLOAD) {
+    return false;
+  }
+  payload[0] = status;
+  memcpy(payload + 1, data, len);
+  return send(type, payload, len + 1);
+}
+
+bool Telemetry::send(uint8_t type, const uint8_t *payload, uint8_t len) {
+  if (type != TELEMETRY_SAMPLES && batch[0] != 0) {
+    sendBatch();
+  }
+
+  // sync + len + type + payload + crc
+  if (len > TELEMETRY_MAX_PAYLOAD || queue.space() < len + 4) {
+    if (dropped < 0xFFFF) {
+      dropped++;
+    }
+    return false;
+  }
+
+  uint8_t frameLen = len + 1;
+  uint8_t crc = crc8Update(crc8Update(CRC8_INIT, frameLen), type);
+
+  queue.push(TELEMETRY_SYNC);
+  queue.push(frameLen);
+  queue.push(type);
+  for (uint8_t i = 0; i < len; i++) {
+    queue.push(payload[i]);
+    crc = crc8Update(crc, payload[i]);
+  }
+  queue.push(crc);
+  return true;
+}
+
+bool Telemetry::canSend(uint8_t len) const {
+  // A batch in progress goes out first
+  uint16_t needed = len + 4;
+  if (batch[0] != 0) {
+    needed += batchLen + 4;
+  }
+  return len <= TELEMETRY_MAX_PAYLOAD && queue.space() >= needed;
+}
+
+void Telemetry::service() {
+  if (batch[0] != 0 && millis() - batchStarted >= TELEMETRY_BATCH_AGE) {
+    sendBatch();
+  }
+
+  int room = Serial.availableForWrite();
+  uint8_t b;
+  while (room-- > 0 && queue.pop(b)) {
+    Serial.write(b);
+  }
+}
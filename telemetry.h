@@ -0,0 +1,109 @@
+/**
+ * Framed binary telemetry over Serial.
+ *
+ * Packets are queued in a TX ring buffer and service() hands bytes to the
+ * UART only as fast as its own buffer has room (Serial.availableForWrite()),
+ * so sending never blocks the caller. When the link can't keep up whole
+ * packets are dropped and counted; a packet is never truncated.
+ *
+ * Frame layout:
+ *   0xA5 sync | len | type | payload (len - 1 bytes) | CRC-8 of len..payload
+ *
+ * Samples go out in batches of up to TELEMETRY_BATCH_SAMPLES, as soon as a
+ * batch is full (or TELEMETRY_BATCH_AGE after its first sample), and any
+ * other packet sends the batch in progress first so the order holds.
+ *
+ * Payloads are little endian:
+ *   TELEMETRY_SAMPLES uint8 count, int32 raw count (sum of all channels)
+ *                     and int32 weight (grams) of the first sample, then
+ *                     per further sample its raw and weight deltas as
+ *                     zig-zag varints (sample_codec.h). A steady reading
+ *                     costs ~2.5 bytes per sample instead of a 12-byte
+ *                     frame each.
+ *   TELEMETRY_LOAD    uint32 end time (ms), int32 payload (grams),
+ *                     int32 peak (grams), uint16 duration (s)
+ *   TELEMETRY_PROFILE uint8 section, uint32 count, uint16 min, uint16 max,
+ *                     uint16 avg (all us), uint16 overruns
+ *   TELEMETRY_STATS   uint8 aggregate (TelemetryStatsKind), uint16 count,
+ *                     int64 sum, int32 min, int32 max, int32 mean,
+ *                     int32 standard deviation (all grams)
+ *
+ * Replies to host requests share the stream; see command_parser.h.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include "ring_buffer.h"
+
+#define TELEMETRY_SYNC 0xA5
+#define TELEMETRY_QUEUE_SIZE 128
+#define TELEMETRY_MAX_PAYLOAD 48
+#define TELEMETRY_BATCH_SAMPLES 16
+#define TELEMETRY_BATCH_AGE 250  // ms
+#define TELEMETRY_STATS_SIZE 27
+
+// 0x01 was a single sample per frame, before TELEMETRY_SAMPLES
+enum TelemetryType {
+  TELEMETRY_LOAD = 0x02,
+  TELEMETRY_PROFILE = 0x03,
+  TELEMETRY_STATS = 0x04,
+  TELEMETRY_SAMPLES = 0x05
+};
+
+enum TelemetryStatsKind {
+  STATS_SHIFT,
+  STATS_DAY,
+  STATS_PREVIOUS_SHIFT,
+  STATS_PREVIOUS_DAY
+};
+
+class Telemetry {
+public:
+  Telemetry();
+
+  void begin(unsigned long baud);
+
+  // Add a sample to the batch, sending the batch once it is full
+  void sendSample(int32_t raw, int32_t grams);
+  void sendLoad(unsigned long endedAt, int32_t payload, int32_t peak, uint16_t duration);
+  bool sendProfile(uint8_t section, uint32_t count, uint16_t min, uint16_t max, uint16_t avg, uint16_t overruns);
+  bool sendStats(uint8_t kind, uint16_t count, int64_t sum, int32_t min, int32_t max, int32_t mean, int32_t stddev);
+
+  // Reply to a host request: status, then data (see command_parser.h)
+  bool sendReply(uint8_t type, uint8_t status, const uint8_t *data, uint8_t len);
+
+  // The TELEMETRY_STATS payload, TELEMETRY_STATS_SIZE bytes, at dst
+  static void packStats(uint8_t *dst, uint8_t kind, uint16_t count, int64_t sum, int32_t min, int32_t max, int32_t mean, int32_t stddev);
+
+  // Queue an arbitrary packet. Returns false (and counts a drop) if it
+  // doesn't fit in the queue.
+  bool send(uint8_t type, const uint8_t *payload, uint8_t len);
+
+  // Whether a packet of len payload bytes would be queued now
+  bool canSend(uint8_t len) const;
+
+  // Move queued bytes into the UART without blocking. Call often.
+  void service();
+
+  // Nothing left to move into the UART
+  bool idle() const { return queue.empty(); }
+
+  uint16_t droppedPackets() const { return dropped; }
+
+private:
+  void sendBatch();
+
+  RingBuffer<uint8_t, TELEMETRY_QUEUE_SIZE> queue;
+  uint16_t dropped;
+
+  // TELEMETRY_SAMPLES payload being built; batch[0] is the sample count
+  uint8_t batch[TELEMETRY_MAX_PAYLOAD];
+  uint8_t batchLen;
+  int32_t batchRaw;    // last sample in it
+  int32_t batchGrams;
+  unsigned long batchStarted;
+};
+
+#endif
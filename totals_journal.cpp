@@ -0,0 +1,25 @@
+#include "totals_journal.h"
+
+TotalsJournal::TotalsJournal(int baseAddress, uint8_t slots) : ring(baseAddress, slots) {
+}
+
+bool TotalsJournal::begin(uint16_t &loadCount, int64_t &totalWeight) {
+  uint8_t payload[EEPROM_RING_PAYLOAD];
+  if (!ring.begin() || !ring.read(ring.newestSequence(), payload)) {
+    return false;
+  }
+
+  loadCount = payload[0] | (uint16_t) payload[1] << 8;
+  totalWeight = (int64_t) ((uint64_t) ringReadU32(payload + 2) | (uint64_t) ringReadU32(payload + 6) << 32);
+  return true;
+}
+
+bool TotalsJournal::append(uint16_t loadCount, int64_t totalWeight) {
+  uint8_t payload[EEPROM_RING_PAYLOAD];
+  payload[0] = loadCount & 0xFF;
+  payload[1] = loadCount >> 8;
+  ringWriteU32(payload + 2, (uint32_t) totalWeight);
+  ringWriteU32(payload + 6, (uint32_t) ((uint64_t) totalWeight >> 32));
+  payload[10] = 0;
+  return ring.append(payload);
+}
@@ -0,0 +1,39 @@
+/**
+ * Wear-leveled journal for the load count and total weight.
+ *
+ * Instead of rewriting the same EEPROM cells, every save appends a record
+ * to an EEPROMRing (see eeprom_ring.h) and boot restores the newest valid
+ * one. Saves are written in the background by service().
+ *
+ * Payload layout (little endian):
+ *   0  uint16 load count
+ *   2  int64  total weight (grams)
+ *   10 uint8  reserved
+ */
+
+#ifndef TOTALS_JOURNAL_H
+#define TOTALS_JOURNAL_H
+
+#include "eeprom_ring.h"
+
+class TotalsJournal {
+public:
+  TotalsJournal(int baseAddress, uint8_t slots);
+
+  // Restore the newest valid record. Returns false (leaving the arguments
+  // untouched) if the journal is empty or corrupt.
+  bool begin(uint16_t &loadCount, int64_t &totalWeight);
+
+  // Stage a record for writing. Returns false if the previous record is
+  // still being written; try again once busy() is false.
+  bool append(uint16_t loadCount, int64_t totalWeight);
+
+  void service() { ring.service(); }
+  bool busy() const { return ring.busy(); }
+  uint32_t sequence() const { return ring.newestSequence(); }
+
+private:
+  EEPROMRing ring;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "touch_input.h"
+
+TouchInput::TouchInput(TouchScreen &ts, uint8_t xm, uint8_t yp)
+  : ts(ts), xm(xm), yp(yp), state(IDLE), samples(0), sumX(0), sumY(0), sumZ(0),
+    pressedAt(0), longReported(false), nextRead(0) {
+  press.type = TOUCH_NONE;
+  press.x = press.y = press.z = 0;
+}
+
+bool TouchInput::pressed(int16_t z) const {
+  return z > ts.pressureThreshhold && z < TOUCH_MAX_PRESSURE;
+}
+
+bool TouchInput::update(unsigned long now, TouchEvent &event) {
+  if (!due(now)) {
+    return false;
+  }
+
+  bool report = false;
+
+  switch (state) {
+    case IDLE: {
+      // Pressure only; position isn't needed until something touches
+      int16_t z = ts.pressure();
+      if (pressed(z)) {
+        state = DEBOUNCE;
+        samples = 0;
+        sumX = sumY = sumZ = 0;
+      }
+      break;
+    }
+
+    case DEBOUNCE: {
+      TSPoint p = ts.getPoint();
+      if (!pressed(p.z)) {
+        state = IDLE;
+        break;
+      }
+      sumX += p.x;
+      sumY += p.y;
+      sumZ += p.z;
+      if (++samples >= TOUCH_DEBOUNCE_SAMPLES) {
+        press.type = TOUCH_PRESS;
+        press.x = sumX / samples;
+        press.y = sumY / samples;
+        press.z = sumZ / samples;
+        event = press;
+        report = true;
+        state = PRESSED;
+        samples = 0;
+        pressedAt = now;
+        longReported = false;
+      }
+      break;
+    }
+
+    case PRESSED: {
+      int16_t z = ts.pressure();
+      if (pressed(z)) {
+        samples = 0;
+        if (!longReported && now - pressedAt >= TOUCH_LONG_PRESS_TIME) {
+          longReported = true;
+          event = press;
+          event.type = TOUCH_LONG_PRESS;
+          report = true;
+        }
+      } else if (++samples >= TOUCH_RELEASE_SAMPLES) {
+        event = press;
+        event.type = TOUCH_RELEASE;
+        report = true;
+        state = IDLE;
+      }
+      break;
+    }
+  }
+
+  // Give the shared pins back to the display
+  pinMode(xm, OUTPUT);
+  pinMode(yp, OUTPUT);
+
+  nextRead = now + (state == IDLE ? TOUCH_IDLE_INTERVAL : TOUCH_ACTIVE_INTERVAL);
+  return report;
+}
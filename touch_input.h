@@ -0,0 +1,78 @@
+/**
+ * Debounced, event-based touchscreen input.
+ *
+ * The resistive panel is sampled on a schedule of its own: a cheap
+ * pressure-only read every TOUCH_IDLE_INTERVAL while nothing is touching
+ * it, and full reads every TOUCH_ACTIVE_INTERVAL only once a touch has
+ * been seen. A press is reported after TOUCH_DEBOUNCE_SAMPLES consecutive
+ * pressed reads, at the average of their positions and pressures, and a
+ * release after TOUCH_RELEASE_SAMPLES consecutive released reads. A press
+ * held for TOUCH_LONG_PRESS_TIME also reports one long press. Each
+ * physical press therefore produces exactly one TOUCH_PRESS, however long
+ * it is held.
+ *
+ * The X-/Y+ pins are shared with the TFT; every read hands them back to
+ * the display as outputs.
+ */
+
+#ifndef TOUCH_INPUT_H
+#define TOUCH_INPUT_H
+
+#include <Arduino.h>
+#include <TouchScreen.h>
+
+#define TOUCH_IDLE_INTERVAL    100   // ms between reads with nothing touching
+#define TOUCH_ACTIVE_INTERVAL  10    // ms between reads during a touch
+#define TOUCH_DEBOUNCE_SAMPLES 3
+#define TOUCH_RELEASE_SAMPLES  3
+#define TOUCH_LONG_PRESS_TIME  800   // ms
+#define TOUCH_MAX_PRESSURE     1000  // readings above this are noise
+
+enum TouchEventType {
+  TOUCH_NONE,
+  TOUCH_PRESS,
+  TOUCH_RELEASE,
+  TOUCH_LONG_PRESS
+};
+
+// Panel coordinates (not yet mapped to the screen) of the press
+struct TouchEvent {
+  TouchEventType type;
+  int16_t x;
+  int16_t y;
+  int16_t z;
+};
+
+class TouchInput {
+public:
+  TouchInput(TouchScreen &ts, uint8_t xm, uint8_t yp);
+
+  // True when the next read is due; lets the caller skip (or time) reads.
+  bool due(unsigned long now) const { return (long) (now - nextRead) >= 0; }
+
+  // Take a reading if one is due. Returns true and fills `event` when it
+  // completes a press, release or long press.
+  bool update(unsigned long now, TouchEvent &event);
+
+  bool touching() const { return state != IDLE; }
+
+private:
+  enum State { IDLE, DEBOUNCE, PRESSED };
+
+  bool pressed(int16_t z) const;
+
+  TouchScreen &ts;
+  uint8_t xm;
+  uint8_t yp;
+  State state;
+  uint8_t samples;
+  int32_t sumX;
+  int32_t sumY;
+  int32_t sumZ;
+  TouchEvent press;
+  unsigned long pressedAt;
+  bool longReported;
+  unsigned long nextRead;
+};
+
+#endif
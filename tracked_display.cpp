@@ -0,0 +1,88 @@
+#include "tracked_display.h"
+
+#define ALL_TILES ((1U << TRACK_TILES) - 1)
+
+// Nothing is known about the panel at power-up, so all of it is dirty
+TrackedDisplay::TrackedDisplay(uint16_t background) : bg(background) {
+  for (uint8_t r = 0; r < TRACK_TILES; r++) {
+    dirty[r] = ALL_TILES;
+  }
+}
+
+void TrackedDisplay::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (color != bg) {
+    mark(x, y, x + 1, y + 1);
+  }
+  MCUFRIEND_kbv::drawPixel(x, y, color);
+}
+
+void TrackedDisplay::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  int16_t x0 = w < 0 ? x + w : x;
+  int16_t y0 = h < 0 ? y + h : y;
+  int16_t x1 = x0 + abs(w);
+  int16_t y1 = y0 + abs(h);
+  if (color != bg) {
+    mark(x0, y0, x1, y1);
+  } else {
+    unmark(x0, y0, x1, y1);
+  }
+  MCUFRIEND_kbv::fillRect(x, y, w, h, color);
+}
+
+// Tiles touched by [x0, x1) x [y0, y1)
+void TrackedDisplay::mark(int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 > width()) x1 = width();
+  if (y1 > height()) y1 = height();
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+  uint8_t c0 = x0 >> TRACK_TILE_SHIFT;
+  uint8_t c1 = (x1 - 1) >> TRACK_TILE_SHIFT;
+  uint16_t bits = (ALL_TILES >> (TRACK_TILES - 1 - c1)) & ~((1U << c0) - 1);
+  for (uint8_t r = y0 >> TRACK_TILE_SHIFT; r <= (y1 - 1) >> TRACK_TILE_SHIFT; r++) {
+    dirty[r] |= bits;
+  }
+}
+
+// Tiles wholly inside [x0, x1) x [y0, y1), which the screen edges close
+void TrackedDisplay::unmark(int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 >= width()) x1 = TRACK_TILES * TRACK_TILE;
+  if (y1 >= height()) y1 = TRACK_TILES * TRACK_TILE;
+  int16_t c0 = (x0 + TRACK_TILE - 1) >> TRACK_TILE_SHIFT;
+  int16_t c1 = x1 >> TRACK_TILE_SHIFT;  // exclusive
+  int16_t r0 = (y0 + TRACK_TILE - 1) >> TRACK_TILE_SHIFT;
+  int16_t r1 = y1 >> TRACK_TILE_SHIFT;
+  if (c0 >= c1 || r0 >= r1) {
+    return;
+  }
+  uint16_t bits = (ALL_TILES >> (TRACK_TILES - c1)) & ~((1U << c0) - 1);
+  for (int16_t r = r0; r < r1; r++) {
+    dirty[r] &= ~bits;
+  }
+}
+
+void TrackedDisplay::clearDrawn() {
+  for (uint8_t r = 0; r < TRACK_TILES; r++) {
+    uint16_t bits = dirty[r];
+    uint8_t c = 0;
+    while (bits) {
+      if (!(bits & 1)) {
+        bits >>= 1;
+        c++;
+        continue;
+      }
+      uint8_t run = 0;
+      while (bits & 1) {
+        bits >>= 1;
+        run++;
+      }
+      MCUFRIEND_kbv::fillRect(c * TRACK_TILE, r * TRACK_TILE, run * TRACK_TILE, TRACK_TILE, bg);
+      c += run;
+    }
+    dirty[r] = 0;
+  }
+}
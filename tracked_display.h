@@ -0,0 +1,48 @@
+/**
+ * MCUFRIEND_kbv display that remembers where it has drawn, so a page
+ * change only clears what the old page left on screen.
+ *
+ * The screen is split into TRACK_TILE x TRACK_TILE pixel tiles with one
+ * dirty bit each. Every pixel or rectangle drawn in a colour other than
+ * the background marks the tiles it touches; a background fill covering
+ * whole tiles clears their bits. clearDrawn() then blanks only the dirty
+ * tiles, one fillRect() (an address window and a run of pixels) per run
+ * of them along a tile row, instead of all 153,600 pixels.
+ *
+ * After a clear the screen is known to be background, which is what
+ * DisplayField::cleared() and SegmentField::cleared() tell the fields, so
+ * a freshly drawn page only paints its ink.
+ *
+ * RAM: one uint16_t per tile row, 30 bytes.
+ */
+
+#ifndef TRACKED_DISPLAY_H
+#define TRACKED_DISPLAY_H
+
+#include <MCUFRIEND_kbv.h>
+
+#define TRACK_TILE_SHIFT 5
+#define TRACK_TILE       (1 << TRACK_TILE_SHIFT)
+#define TRACK_TILES      15  // 480 pixels, the long side
+
+class TrackedDisplay : public MCUFRIEND_kbv {
+public:
+  explicit TrackedDisplay(uint16_t background);
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color);
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+
+  // Blank every tile drawn on since the last clear
+  void clearDrawn();
+
+  uint16_t background() const { return bg; }
+
+private:
+  void mark(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+  void unmark(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+
+  uint16_t bg;
+  uint16_t dirty[TRACK_TILES];  // bit c of row r: tile (c, r)
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "weight_filter.h"
+
+#define IIR_ONE ((int64_t) 1 << FILTER_IIR_FRAC_BITS)
+
+WeightFilter::WeightFilter() {
+  configure(FILTER_NONE, 1);
+}
+
+void WeightFilter::configure(FilterType type, uint8_t param) {
+  kind = type;
+  window = 1;
+  shift = 0;
+
+  switch (type) {
+    case FILTER_MOVING_AVERAGE:
+    case FILTER_MEDIAN:
+      window = param < 1 ? 1 : (param > FILTER_MAX_WINDOW ? FILTER_MAX_WINDOW : param);
+      break;
+    case FILTER_IIR:
+      shift = param > 16 ? 16 : param;
+      break;
+    default:
+      break;
+  }
+  reset();
+}
+
+void WeightFilter::reset() {
+  index = 0;
+  count = 0;
+  sum = 0;
+  state = 0;
+}
+
+int32_t WeightFilter::update(int32_t sample) {
+  switch (kind) {
+    case FILTER_MOVING_AVERAGE: {
+      // Replace the oldest sample in the running sum
+      if (count >= window) {
+        sum -= history[index];
+      } else {
+        count++;
+      }
+      history[index] = sample;
+      sum += sample;
+      index = (index + 1) % window;
+      return sum / count;
+    }
+
+    case FILTER_MEDIAN:
+      history[index] = sample;
+      index = (index + 1) % window;
+      if (count < window) {
+        count++;
+      }
+      return median();
+
+    case FILTER_IIR:
+      // Start from the first sample instead of ramping up from zero
+      if (count == 0) {
+        state = sample * IIR_ONE;
+        count = 1;
+      } else {
+        state += (sample * IIR_ONE - state) >> shift;
+      }
+      return (int32_t) (state >> FILTER_IIR_FRAC_BITS);
+
+    default:
+      count = 1;
+      return sample;
+  }
+}
+
+// Insertion sort of a copy of the window; fine for the small windows
+// this kernel is meant for
+int32_t WeightFilter::median() const {
+  int32_t sorted[FILTER_MAX_WINDOW];
+  for (uint8_t i = 0; i < count; i++) {
+    int32_t v = history[i];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > v) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = v;
+  }
+  return sorted[count / 2];
+}
@@ -0,0 +1,63 @@
+/**
+ * Integer filter stage for the weight in grams.
+ *
+ * One WeightFilter is one stage with a selectable kernel; stages are chained
+ * by feeding the output of one into the next. Everything runs in integer
+ * math over a static history buffer, with no heap use:
+ *
+ * - FILTER_MOVING_AVERAGE: fixed-window mean, O(1) per sample (running sum,
+ *   int32: a full window of 16 holds up to 134 t).
+ * - FILTER_MEDIAN: median of the last `window` samples for spike rejection.
+ *   Cost grows with window^2, so keep it small (3..7).
+ * - FILTER_IIR: single-pole low-pass y += (x - y) / 2^shift, O(1) per sample,
+ *   with FILTER_IIR_FRAC_BITS of fractional state to avoid truncation bias.
+ *   The state is int64, as grams << FILTER_IIR_FRAC_BITS pass int32 above
+ *   33.5 t.
+ */
+
+#ifndef WEIGHT_FILTER_H
+#define WEIGHT_FILTER_H
+
+#include <stdint.h>
+
+#define FILTER_MAX_WINDOW 16
+#define FILTER_IIR_FRAC_BITS 6
+
+enum FilterType {
+  FILTER_NONE,
+  FILTER_MOVING_AVERAGE,
+  FILTER_MEDIAN,
+  FILTER_IIR
+};
+
+class WeightFilter {
+public:
+  WeightFilter();
+
+  // param is the window length for the moving average and median
+  // (clamped to FILTER_MAX_WINDOW) and the shift for the IIR.
+  void configure(FilterType type, uint8_t param);
+  void reset();
+
+  int32_t update(int32_t sample);
+
+  // True once the window is full (always true for FILTER_NONE / FILTER_IIR
+  // after the first sample)
+  bool settled() const { return count >= window; }
+
+  FilterType type() const { return kind; }
+
+private:
+  int32_t median() const;
+
+  FilterType kind;
+  uint8_t window;
+  uint8_t shift;
+  uint8_t index;
+  uint8_t count;
+  int32_t sum;
+  int64_t state;  // FILTER_IIR, grams << FILTER_IIR_FRAC_BITS
+  int32_t history[FILTER_MAX_WINDOW];
+};
+
+#endif
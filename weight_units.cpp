@@ -0,0 +1,9 @@
+#include "weight_units.h"
+
+int64_t gramsPerCount(int32_t calibrationFactor) {
+  return ((int64_t) 1000 << (GRAMS_PER_COUNT_FRAC_BITS + CAL_FACTOR_FRAC_BITS)) / calibrationFactor;
+}
+
+long roundedDiv(int64_t value, long divisor) {
+  return (long) (value >= 0 ? (value + divisor / 2) / divisor : (value - divisor / 2) / divisor);
+}
@@ -0,0 +1,29 @@
+/**
+ * Fixed-point conversion from HX711 counts to grams.
+ *
+ * The calibration factor is raw counts per kg with CAL_FACTOR_FRAC_BITS
+ * fractional bits. It is turned once into a Q24 grams-per-count gain, so
+ * converting a sample is one 64-bit multiply and shift, with no division
+ * and no soft-float.
+ */
+
+#ifndef WEIGHT_UNITS_H
+#define WEIGHT_UNITS_H
+
+#include <stdint.h>
+
+#define CAL_FACTOR_FRAC_BITS 8
+#define DEFAULT_CAL_FACTOR (-7050L * (1L << CAL_FACTOR_FRAC_BITS))
+#define GRAMS_PER_COUNT_FRAC_BITS 24
+
+// Q24 grams-per-count gain for a calibration factor (must be non-zero)
+int64_t gramsPerCount(int32_t calibrationFactor);
+
+inline int32_t countsToGrams(int32_t counts, int64_t gramsPerCount) {
+  return (int32_t) (((int64_t) counts * gramsPerCount) >> GRAMS_PER_COUNT_FRAC_BITS);
+}
+
+// Integer division rounded to nearest, for converting to display units
+long roundedDiv(int64_t value, long divisor);
+
+#endif
@@ -0,0 +1,69 @@
+#include "widget.h"
+
+static void drawButton(Adafruit_GFX &gfx, int16_t x, int16_t y, int16_t w, int16_t h,
+                       uint16_t color, uint16_t ink, uint8_t labelX, const char *label) {
+  gfx.fillRect(x, y, w, h, color);
+  gfx.drawRect(x, y, w, h, ink);
+  gfx.setTextColor(ink);
+  gfx.setTextSize(WIDGET_TEXT_SIZE);
+  gfx.setCursor(x + labelX, y + WIDGET_LABEL_Y);
+  gfx.print(label);
+}
+
+void drawWidgets(Adafruit_GFX &gfx, const Widget *table, uint8_t count, uint16_t ink) {
+  for (uint8_t i = 0; i < count; i++) {
+    Widget w;
+    memcpy_P(&w, &table[i], sizeof(w));
+    drawButton(gfx, w.x, w.y, w.w, w.h, w.color, ink, w.labelX, w.label);
+  }
+}
+
+void drawGrid(Adafruit_GFX &gfx, const WidgetGrid *grid, uint16_t ink) {
+  WidgetGrid g;
+  memcpy_P(&g, grid, sizeof(g));
+  char label[2] = { 0, 0 };
+  for (uint8_t row = 0; row < g.rows; row++) {
+    for (uint8_t col = 0; col < g.cols; col++) {
+      label[0] = g.keys[row * g.cols + col];
+      drawButton(gfx, g.x + col * (g.keyW + g.spacing), g.y + row * (g.keyH + g.spacing),
+                 g.keyW, g.keyH, g.color, ink, g.labelX, label);
+    }
+  }
+}
+
+uint8_t hitWidget(const Widget *table, uint8_t count, int16_t x, int16_t y) {
+  for (uint8_t i = 0; i < count; i++) {
+    Widget w;
+    memcpy_P(&w, &table[i], sizeof(w));
+    if (x > w.x && x < w.x + w.w && y > w.y && y < w.y + w.h) {
+      return w.action;
+    }
+  }
+  return WIDGET_NONE;
+}
+
+char hitGrid(const WidgetGrid *grid, int16_t x, int16_t y) {
+  WidgetGrid g;
+  memcpy_P(&g, grid, sizeof(g));
+  int16_t dx = x - g.x;
+  int16_t dy = y - g.y;
+  if (dx <= 0 || dy <= 0) {
+    return WIDGET_NONE;
+  }
+
+  uint8_t pitchX = g.keyW + g.spacing;
+  uint8_t pitchY = g.keyH + g.spacing;
+  uint16_t col = dx / pitchX;
+  uint16_t row = dy / pitchY;
+  if (col >= g.cols || row >= g.rows) {
+    return WIDGET_NONE;
+  }
+
+  // Inside the key, not on its edge or in the gap after it
+  int16_t inX = dx - col * pitchX;
+  int16_t inY = dy - row * pitchY;
+  if (inX == 0 || inX >= g.keyW || inY == 0 || inY >= g.keyH) {
+    return WIDGET_NONE;
+  }
+  return g.keys[row * g.cols + col];
+}
@@ -0,0 +1,64 @@
+/**
+ * Table-driven buttons for the touchscreen.
+ *
+ * A screen's buttons are described once, in a const table in flash
+ * (PROGMEM), and the same table is used to draw them and to hit-test
+ * touches, so geometry can't drift between the two. Each Widget carries
+ * an action code that hitWidget() returns; the sketch decides what the
+ * codes mean (the keypad simply uses the key character).
+ *
+ * A WidgetGrid is a uniform block of keys such as the calibration keypad.
+ * Hit-testing a grid is one division per axis rather than a scan over
+ * every key. Touches on the gap between keys hit nothing.
+ *
+ * Tables must be declared PROGMEM; entries are copied to the stack one at
+ * a time with memcpy_P, so a table costs no SRAM.
+ */
+
+#ifndef WIDGET_H
+#define WIDGET_H
+
+#include <Adafruit_GFX.h>
+
+#define WIDGET_LABEL_MAX     7
+#define WIDGET_GRID_MAX_KEYS 16
+#define WIDGET_TEXT_SIZE     2
+
+// Labels sit this far below the top edge of the button
+#define WIDGET_LABEL_Y 10
+
+#define WIDGET_NONE 0
+
+struct Widget {
+  int16_t x;
+  int16_t y;
+  int16_t w;
+  int16_t h;
+  uint16_t color;
+  uint8_t labelX;                   // label offset from the left edge
+  char label[WIDGET_LABEL_MAX + 1];
+  uint8_t action;
+};
+
+struct WidgetGrid {
+  int16_t x;
+  int16_t y;
+  uint8_t keyW;
+  uint8_t keyH;
+  uint8_t spacing;
+  uint8_t rows;
+  uint8_t cols;
+  uint8_t labelX;
+  uint16_t color;
+  char keys[WIDGET_GRID_MAX_KEYS];  // row major, also the action codes
+};
+
+// Draw every widget in a PROGMEM table with an `ink` border and label
+void drawWidgets(Adafruit_GFX &gfx, const Widget *table, uint8_t count, uint16_t ink);
+void drawGrid(Adafruit_GFX &gfx, const WidgetGrid *grid, uint16_t ink);
+
+// Action code of the widget under (x, y), or WIDGET_NONE
+uint8_t hitWidget(const Widget *table, uint8_t count, int16_t x, int16_t y);
+char hitGrid(const WidgetGrid *grid, int16_t x, int16_t y);
+
+#endif
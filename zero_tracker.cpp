@@ -0,0 +1,67 @@
+#include "zero_tracker.h"
+
+ZeroTracker::ZeroTracker(const ZeroTrackerConfig &config) : cfg(config) {
+  reset();
+}
+
+void ZeroTracker::reset() {
+  tracked = 0;
+  drift = 0;
+  haveReference = false;
+  restartWindow();
+}
+
+void ZeroTracker::restartWindow() {
+  count = 0;
+  sum = 0;
+}
+
+void ZeroTracker::update(int32_t grams, bool idle) {
+  if (!idle || grams > cfg.band || grams < -cfg.band) {
+    restartWindow();
+    return;
+  }
+
+  if (count == 0) {
+    low = high = grams;
+  } else if (grams < low) {
+    low = grams;
+  } else if (grams > high) {
+    high = grams;
+  }
+  if (high - low > cfg.stableBand) {
+    restartWindow();
+    return;
+  }
+
+  sum += grams;
+  if (++count < cfg.windowSamples) {
+    return;
+  }
+
+  // A steady empty window: move zero towards its mean, at a bounded rate
+  int32_t step = sum / (int32_t) count;
+  if (step > cfg.maxStep) {
+    step = cfg.maxStep;
+  } else if (step < -cfg.maxStep) {
+    step = -cfg.maxStep;
+  }
+  tracked += step;
+  if (tracked > cfg.range) {
+    tracked = cfg.range;
+  } else if (tracked < -cfg.range) {
+    tracked = -cfg.range;
+  }
+  restartWindow();
+}
+
+void ZeroTracker::setTemperature(int16_t deciCelsius) {
+  if (cfg.gramsPerDegree == 0) {
+    return;
+  }
+  if (!haveReference) {
+    reference = deciCelsius;
+    haveReference = true;
+  }
+  drift = (int32_t) (deciCelsius - reference) * cfg.gramsPerDegree / 10;
+}
@@ -0,0 +1,66 @@
+/**
+ * Automatic zero tracking for the filtered weight stream.
+ *
+ * While the scale is empty (no load event in progress, within `band` of
+ * zero) and steady (a window of `windowSamples` samples spans no more than
+ * `stableBand`), the mean of each window is taken as zero drift and the
+ * zero correction moves towards it by at most `maxStep`. So the correction
+ * follows slow thermal drift at a bounded rate, but a truck rolling on
+ * (not idle), settling dust (not near zero) or a vibrating deck (not
+ * steady) never moves it. The total correction is limited to ±range.
+ *
+ * Optionally a temperature reading feeds a linear drift model, which
+ * keeps the zero right while the scale is loaded and can't be tracked.
+ * What the model misses is still tracked.
+ *
+ * update() is O(1) and nothing is buffered.
+ */
+
+#ifndef ZERO_TRACKER_H
+#define ZERO_TRACKER_H
+
+#include <stdint.h>
+
+struct ZeroTrackerConfig {
+  int32_t band;             // grams; only readings this close to zero are tracked
+  int32_t stableBand;       // grams; largest spread of a window that is tracked
+  uint16_t windowSamples;   // samples per correction step
+  int32_t maxStep;          // grams; largest correction per window
+  int32_t range;            // grams; largest total correction either way
+  int16_t gramsPerDegree;   // temperature drift model, 0 for none
+};
+
+class ZeroTracker {
+public:
+  explicit ZeroTracker(const ZeroTrackerConfig &config);
+
+  // Back to no correction, e.g. after a tare. The temperature at the next
+  // setTemperature() becomes the model's reference.
+  void reset();
+
+  // Feed one filtered sample with the correction already removed, and
+  // whether the load detector is idle
+  void update(int32_t grams, bool idle);
+
+  // Latest temperature reading, in tenths of a degree C
+  void setTemperature(int16_t deciCelsius);
+
+  // Grams to subtract from the filtered weight
+  int32_t correction() const { return tracked + drift; }
+
+private:
+  void restartWindow();
+
+  ZeroTrackerConfig cfg;
+  int32_t tracked;        // correction found by tracking
+  int32_t drift;          // correction from the temperature model
+  bool haveReference;
+  int16_t reference;      // temperature at the last reset
+
+  uint16_t count;
+  int32_t sum;
+  int32_t low;
+  int32_t high;
+};
+
+#endif